@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+// Operation classes shared by the injector's binary records and the
+// receiver. Values are stored in spool files, so only append new entries.
+enum class SysOp : uint8_t {
+    Write,
+    Writev,
+    Pwrite,
+    Pwritev,
+    Truncate,
+    Msync,
+    Fallocate,
+    Read,
+    Readv,
+    Pread,
+    Preadv,
+    Getdents,
+    Transfer,
+    Open,
+    Close,
+    Dup,
+    Pipe,
+    Rename,
+    Link,
+    SymLink,
+    Unlink,
+    NetSend,
+    NetRecv,
+    Exec,
+    Spawn,
+    Fork,
+    System,
+    ProcessStart,
+    ProcessEnd,
+    JobStart,
+    JobEnd,
+    Unknown
+};
+
+// Class names for configuration (PROV_OPS, PROV_SAMPLE), in enum order.
+inline constexpr std::string_view sysop_names[] = {
+    "write", "writev", "pwrite", "pwritev", "truncate", "msync", "fallocate",
+    "read", "readv", "pread", "preadv", "getdents", "transfer", "open", "close",
+    "dup", "pipe", "rename", "link", "symlink", "unlink", "net_send",
+    "net_recv", "exec", "spawn", "fork", "system", "process_start",
+    "process_end", "job_start", "job_end", "unknown"};
+
+inline constexpr size_t sysop_count = std::size(sysop_names);
+static_assert(sysop_count == static_cast<size_t>(SysOp::Unknown) + 1);
+
+// Returns false for a name that is not a class.
+inline bool sysop_from_name(std::string_view name, SysOp& op) {
+    for (size_t i = 0; i < sysop_count; i++) {
+        if (sysop_names[i] == name) {
+            op = static_cast<SysOp>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Mask of the classes named in a comma-separated list, every class when the
+// list is empty. Process start and end are always included; unknown names
+// are skipped.
+inline uint64_t sysop_mask(std::string_view names) {
+    if (names.empty()) return (uint64_t{1} << sysop_count) - 1;
+    uint64_t mask = uint64_t{1} << static_cast<uint8_t>(SysOp::ProcessStart)
+                    | uint64_t{1} << static_cast<uint8_t>(SysOp::ProcessEnd);
+    while (!names.empty()) {
+        size_t end = names.find(',');
+        SysOp op;
+        if (sysop_from_name(names.substr(0, end), op))
+            mask |= uint64_t{1} << static_cast<uint8_t>(op);
+        names.remove_prefix(end == std::string_view::npos ? names.size()
+                                                          : end + 1);
+    }
+    return mask;
+}
@@ -0,0 +1,154 @@
+// Counts heap allocations while the injector logs I/O events, and fails if
+// logging allocates once it has warmed up:
+//
+//   alloc_bench <libinjector.so> [events]
+//
+// Every measured round opens a path the injector has not seen before. The
+// PROV_* settings to measure come from the environment. The bench re-runs
+// itself with the injector preloaded and its spool in a temporary directory.
+// Its own malloc family counts every call, the injector's included.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void* __libc_memalign(size_t align, size_t size);
+
+static std::atomic<long> allocations{0};
+
+extern "C" void* malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void* memalign(size_t align, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(align, size);
+}
+
+extern "C" void* aligned_alloc(size_t align, size_t size) {
+    return memalign(align, size);
+}
+
+extern "C" int posix_memalign(void** out, size_t align, size_t size) {
+    void* ptr = memalign(align, size);
+    if (!ptr) return ENOMEM;
+    *out = ptr;
+    return 0;
+}
+
+static constexpr const char* child_env = "ALLOC_BENCH_DIR";
+
+// One round of the hooks a typical job hits: an open, reads, a write and a
+// positioned read, and a close.
+static void log_events(const char* input, int output_fd) {
+    char data[64] = "hello\n";
+    int fd = open(input, O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, data, sizeof(data)) < 0) std::perror("read");
+        if (pread(fd, data, 8, 0) < 0) std::perror("pread");
+        close(fd);
+    }
+    if (write(output_fd, data, 6) < 0) std::perror("write");
+}
+
+// The input of measured round `round`, a path of its own.
+static void round_input(char* path, size_t size, const std::string& dir,
+                        long round) {
+    std::snprintf(path, size, "%s/input.%ld.txt", dir.c_str(), round);
+}
+
+// Creates the inputs with raw syscalls, which the injector does not see, so
+// each path is new to it in its round.
+static bool create_inputs(const std::string& dir, long rounds) {
+    char path[4096];
+    for (long round = 0; round < rounds; round++) {
+        round_input(path, sizeof(path), dir, round);
+        int fd = static_cast<int>(syscall(SYS_openat, AT_FDCWD, path,
+                                          O_WRONLY | O_CREAT | O_TRUNC, 0644));
+        if (fd < 0) return false;
+        bool written = syscall(SYS_write, fd, "provenance\n", 11) == 11;
+        syscall(SYS_close, fd);
+        if (!written) return false;
+    }
+    return true;
+}
+
+static int run_events(const std::string& dir, long events) {
+    std::string input = dir + "/input.txt";
+    std::string output = dir + "/output.txt";
+    int fd = open(input.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, "provenance\n", 11) != 11) return 2;
+    close(fd);
+    int output_fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0) return 2;
+    // Five events a round.
+    long rounds = events / 5;
+    if (!create_inputs(dir, rounds)) return 2;
+
+    // Buffers and spool files are set up on first use; this is enough events
+    // to pass the default flush threshold too.
+    for (int i = 0; i < 50000; i++) log_events(input.c_str(), output_fd);
+    char path[4096];
+    long before = allocations.load();
+    for (long round = 0; round < rounds; round++) {
+        round_input(path, sizeof(path), dir, round);
+        log_events(path, output_fd);
+    }
+    long allocated = allocations.load() - before;
+    close(output_fd);
+
+    std::printf("%ld allocations over %ld events\n", allocated, events);
+    return allocated ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (const char* dir = getenv(child_env))
+        return run_events(dir, argc > 2 ? std::atol(argv[2]) : 100000);
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <libinjector.so> [events]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    char dir[] = "/tmp/alloc_bench.XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::perror("mkdtemp");
+        return 2;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv(child_env, dir, 1);
+        setenv("PROV_PATH_EXEC", dir, 1);
+        setenv("PROV_PATH_WRITE", dir, 1);
+        setenv("LD_PRELOAD", argv[1], 1);
+        execv("/proc/self/exe", argv);
+        _exit(127);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0) status = 2 << 8;
+    std::filesystem::remove_all(dir);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Page prov exec shares with every traced process (PROV_CONTROL) so tracing
+// can be switched while the command runs; `prov control` rewrites it. The
+// injector maps it read-only and tests the whole state with one relaxed load
+// of `word`: bit control_enabled switches recording, the low bits are the op
+// classes recorded (SysOp bits, as PROV_OPS).
+
+inline constexpr char control_magic[8] = {'P', 'R', 'O', 'V', 'C', 'T', 'L', 0};
+inline constexpr uint64_t control_enabled = uint64_t{1} << 63;
+
+struct ControlPage {
+    char magic[8];
+    std::atomic<uint64_t> word;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+inline void init_control_page(ControlPage* page, uint64_t word) {
+    std::memcpy(page->magic, control_magic, sizeof(control_magic));
+    page->word.store(word);
+}
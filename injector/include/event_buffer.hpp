@@ -0,0 +1,158 @@
+#pragma once
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "path_summary.hpp"
+#include "record.hpp"
+
+struct InternedPath;
+struct SharedChunk;
+struct SpoolHeader;
+
+// A run of same-class I/O on one fd, folded into a single record when
+// coalescing is enabled. count == 0 means no run is open.
+struct PendingRun {
+    Call call = Call::Count;
+    int fd = -1;
+    const InternedPath* path = nullptr;
+    bool output = false;
+    uint64_t first_ts = 0;
+    uint64_t last_ts = 0;
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+// Calls to one hook and the monotonic ns spent logging them, apart from the
+// real call (PROV_STATS=1).
+struct HookCost {
+    uint64_t calls = 0;
+    uint64_t log_ns = 0;
+};
+
+// What a thread buffer at its memory cap gives up to take a new event.
+enum class DropPolicy : uint8_t {
+    Newest,  // the incoming event
+    Oldest,  // everything buffered and not yet written out
+};
+
+// Streaming limits, in bytes; 0 disables a limit. A buffer reaching
+// flush_bytes is appended to the spool file; one that cannot be written out
+// stops growing at cap_bytes and counts what it drops.
+struct BufferLimits {
+    size_t flush_bytes = size_t{1} << 20;
+    size_t cap_bytes = size_t{64} << 20;
+    DropPolicy drop_policy = DropPolicy::Newest;
+    // Paths each thread's latency table holds before it is written out; 0
+    // while latency profiling is off.
+    size_t latency_paths = 0;
+    // Entries each thread's summary table holds, likewise; 0 outside summary
+    // mode.
+    size_t summary_paths = 0;
+};
+
+extern BufferLimits buffer_limits;
+
+// Events recorded by one thread. Only the owning thread appends to `data`;
+// the flush at process exit is the single reader.
+struct ThreadBuffer {
+    std::string data;
+    // Interned path ids already defined in this thread's binary stream, one
+    // bit per id below interned_path_limit; sized when the buffer registers.
+    std::vector<uint64_t> defined_paths;
+    PendingRun run;
+    // Events in `data`, and events lost to the memory cap.
+    uint64_t buffered_events = 0;
+    uint64_t dropped_events = 0;
+    // Every event recorded, for the overhead summary; flushes keep it.
+    uint64_t recorded_events = 0;
+    HookCost hook_costs[static_cast<size_t>(Call::Count)];
+    // Real call latencies by path (PROV_LATENCY=1); flushes keep them.
+    PathLatencies latencies;
+    // Operations by path in summary mode (PROV_SUMMARY=1); flushes keep them.
+    PathSummaries summaries;
+    // Size at which the next streaming write is attempted.
+    size_t next_flush = 0;
+    // Mapped spool file the events are committed to, if any. spool_path is
+    // set once a mapping was attempted, even if it failed.
+    SpoolHeader* spool = nullptr;
+    size_t spool_size = 0;
+    std::string spool_path;
+    // Open chunk of the shared spool the events are committed to, if any.
+    SharedChunk* shared_chunk = nullptr;
+    // Compressed chunk being written out, and the codec's scratch space.
+    std::string packed;
+    std::vector<uint64_t> codec_state;
+    pid_t tid = 0;
+    std::atomic<bool> writing{false};
+    ThreadBuffer* next = nullptr;
+};
+
+// Preloaded at startup, so the static TLS model is always available.
+extern thread_local ThreadBuffer* local_thread_buffer
+    __attribute__((tls_model("initial-exec")));
+extern std::atomic<bool> events_flushing;
+
+ThreadBuffer* register_thread_buffer();
+// Applies the memory cap before an event is appended. Returns false when the
+// event has to be dropped.
+bool reserve_thread_buffer(ThreadBuffer* buffer);
+// Empties the buffer after its data was handed off. Path definitions are
+// forgotten too, so every chunk written out is self-contained.
+void clear_thread_buffer(ThreadBuffer* buffer);
+// Marks every path undefined, for a stream that starts afresh; the bitmap
+// keeps its size.
+void forget_defined_paths(ThreadBuffer* buffer);
+// Appends the buffered data to `fd` and empties the buffer. On a failed or
+// short write the unwritten tail stays buffered and false is returned.
+bool write_thread_buffer(int fd, ThreadBuffer* buffer);
+// Stops recording and hands every buffer to `flush` once its owner can no
+// longer append.
+void flush_thread_buffers(void (*flush)(ThreadBuffer*));
+// The same, but recording resumes afterwards, for a process that is about to
+// exec; `finish` runs once every buffer is flushed, before it resumes.
+// Returns false, doing nothing, once the exit flush has begun.
+bool checkpoint_thread_buffers(void (*flush)(ThreadBuffer*),
+                               void (*finish)());
+// Appends `chunk`, the buffered events packed into one compressed chunk, to
+// `fd` and empties the buffer. A failed write is cut back off the file, so
+// no partial chunk is left behind, and the events stay buffered.
+bool write_thread_chunk(int fd, ThreadBuffer* buffer,
+                        const std::string& chunk);
+// Creates the spool file at `path` (which must not exist yet) and maps it
+// for the buffer. Returns false if the file cannot be created.
+bool map_thread_spool(ThreadBuffer* buffer, const std::string& path,
+                      uint32_t pid, bool binary, bool compressed);
+// Copies the buffered events into the mapped spool, growing the file as
+// needed, and empties the buffer. Path definitions are kept: the spool is
+// one continuous stream. Returns false, keeping the data, if the file cannot
+// grow.
+bool commit_thread_buffer(ThreadBuffer* buffer);
+// The same for `chunk`, the buffered events packed into one compressed chunk.
+bool commit_thread_chunk(ThreadBuffer* buffer, const std::string& chunk);
+// In a forked child: frees the buffers inherited from the parent, whose
+// events the parent writes out itself. The calling thread registers a fresh
+// buffer, with its new tid, on its next event.
+void reset_thread_buffers_after_fork();
+
+// Returns the calling thread's buffer marked as being written to, or nullptr
+// once the flush has started and events can no longer be recorded.
+static inline ThreadBuffer* acquire_thread_buffer() {
+    ThreadBuffer* buffer = local_thread_buffer;
+    if (!buffer) buffer = register_thread_buffer();
+    buffer->writing.store(true);
+    if (events_flushing.load()) {
+        buffer->writing.store(false);
+        return nullptr;
+    }
+    return buffer;
+}
+
+static inline void release_thread_buffer(ThreadBuffer* buffer) {
+    buffer->writing.store(false, std::memory_order_release);
+}
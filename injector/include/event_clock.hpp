@@ -0,0 +1,57 @@
+#pragma once
+#include <time.h>
+
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Where event timestamps come from (PROV_CLOCK). Every source is system-wide,
+// so raw values from different processes on one node order correctly; prov
+// maps them to wall-clock ns with a single anchor pair per run.
+//   realtime   CLOCK_REALTIME, already wall-clock ns
+//   monotonic  CLOCK_MONOTONIC ns, vDSO
+//   coarse     CLOCK_MONOTONIC_COARSE ns, vDSO, tick resolution
+//   tsc        raw time-stamp counter ticks; needs an invariant TSC, falls
+//              back to monotonic off x86
+enum class ClockSource : uint8_t { Realtime, Monotonic, Coarse, Tsc };
+
+inline constexpr std::string_view clock_source_names[] = {
+    "realtime", "monotonic", "coarse", "tsc"};
+
+inline ClockSource clock_source_from(std::string_view name) {
+    for (uint8_t i = 0; i < std::size(clock_source_names); i++)
+        if (clock_source_names[i] == name) return static_cast<ClockSource>(i);
+    return ClockSource::Realtime;
+}
+
+inline std::string_view clock_source_name(ClockSource source) {
+    return clock_source_names[static_cast<uint8_t>(source)];
+}
+
+inline uint64_t read_clock_id(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline uint64_t read_clock(ClockSource source) {
+    switch (source) {
+        case ClockSource::Monotonic:
+            return read_clock_id(CLOCK_MONOTONIC);
+        case ClockSource::Coarse:
+            return read_clock_id(CLOCK_MONOTONIC_COARSE);
+        case ClockSource::Tsc:
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return read_clock_id(CLOCK_MONOTONIC);
+#endif
+        case ClockSource::Realtime:
+        default:
+            return read_clock_id(CLOCK_REALTIME);
+    }
+}
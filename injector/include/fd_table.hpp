@@ -0,0 +1,18 @@
+#pragma once
+#include "path_table.hpp"
+
+// Paths of the descriptors this process was seen opening, so that hooks on
+// the I/O hot path resolve an fd without a readlink per call.
+void remember_fd(int fd);
+void forget_fd(int fd);
+void forget_fd_range(unsigned int first, unsigned int last);
+void copy_fd(int oldfd, int newfd);
+const InternedPath* lookup_fd(int fd);
+
+// Descriptor kinds not worth recording (PROV_SKIP_FDS, a comma-separated
+// list of pipe, socket, char and anon; all four when unset, "none" for no
+// skipping). remember_fd classifies each fd once, with fstat, and keeps the
+// verdict in a bitmap, so a later hook on a skipped fd returns right after
+// the real call.
+void load_fd_policy();
+bool fd_skipped(int fd);
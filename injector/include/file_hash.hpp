@@ -0,0 +1,47 @@
+#pragma once
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Content digests of the files a process writes (PROV_HASH=1). A regular file
+// opened for writing while empty is hashed with XXH3-128 as the bytes go out,
+// for as long as each write lands where the previous one ended. Once that
+// stops holding (a seek elsewhere, a pwrite at another offset, a truncation,
+// a shared writable mapping, formatted or spliced output whose bytes the
+// hooks never see, or a file that was not empty) the digest is abandoned and
+// the file is reported as needing a hash after the fact. Dups share the state
+// of the file they copy; the digest is taken when the last of them closes.
+struct FileDigest {
+    uint64_t bytes = 0;   // bytes written through the hooks
+    bool hashed = false;  // false: hash the file after the fact
+    uint64_t high = 0;    // XXH3-128 of the content when hashed
+    uint64_t low = 0;
+};
+
+extern bool file_hashing;
+
+void start_file_hash(int fd);
+// Bytes written at the file position, or at `offset` for positioned writes.
+void hash_written(int fd, const void* data, size_t size);
+void hash_written_at(int fd, const void* data, size_t size, off_t offset);
+// The first `size` bytes of the vector.
+void hash_written_iov(int fd, const struct iovec* iov, int iovcnt,
+                      size_t size);
+void hash_written_iov_at(int fd, const struct iovec* iov, int iovcnt,
+                         size_t size, off_t offset);
+// Output through the fd whose bytes are not available to hash.
+void break_file_hash(int fd);
+// The file position of the fd moved to `offset`.
+void seek_file_hash(int fd, uint64_t offset);
+// The file was truncated or extended to `size`.
+void resize_file_hash(int fd, uint64_t size);
+void copy_file_hash(int oldfd, int newfd);
+// Drops the fd's state. True, with `digest` filled in, if this was the last
+// fd on a file that was written to.
+bool finish_file_hash(int fd, FileDigest& digest);
+// The lowest fd >= `fd` with hash state, or -1.
+int next_hashed_fd(int fd);
+// A forked child shares its files with the parent, which keeps hashing them.
+void reset_file_hashes_after_fork();
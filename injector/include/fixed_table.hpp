@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Hash table with linear probing whose slots are allocated once, by reserve,
+// so hooks can count into it without calling malloc. It takes entries up to
+// 3/4 of its slots; past that find_or_add returns nullptr and the owner writes
+// the entries out and clears the table.
+template <class Key, class Value, class Hash>
+class FixedTable {
+   public:
+    // Allocates room for at least `entries`. Only the first call allocates.
+    void reserve(size_t entries) {
+        if (slots) return;
+        size_t count = 8;
+        while (count / 4 * 3 < entries) count *= 2;
+        slots.reset(new Slot[count]);
+        mask = count - 1;
+        limit = count / 4 * 3;
+        shift = 64 - __builtin_ctzll(count);
+    }
+
+    // The value for `key`, value-initialized when it is added, or nullptr
+    // when the table is full or was never reserved.
+    Value* find_or_add(const Key& key) {
+        if (!slots) return nullptr;
+        for (size_t i = slot_of(key);; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.used && slot.key == key) return &slot.value;
+            if (slot.used) continue;
+            if (used == limit) return nullptr;
+            slot.used = true;
+            slot.key = key;
+            slot.value = Value{};
+            used++;
+            return &slot.value;
+        }
+    }
+
+    template <class Visit>
+    void for_each(Visit&& visit) const {
+        if (!used) return;
+        for (size_t i = 0; i <= mask; i++)
+            if (slots[i].used) visit(slots[i].key, slots[i].value);
+    }
+
+    void clear() {
+        if (!used) return;
+        for (size_t i = 0; i <= mask; i++) slots[i].used = false;
+        used = 0;
+    }
+
+    bool empty() const {
+        return !used;
+    }
+    size_t size() const {
+        return used;
+    }
+
+   private:
+    struct Slot {
+        Key key{};
+        Value value{};
+        bool used = false;
+    };
+
+    // Fibonacci hashing spreads keys such as aligned pointers over the slots.
+    size_t slot_of(const Key& key) const {
+        uint64_t hash = static_cast<uint64_t>(Hash()(key));
+        return static_cast<size_t>((hash * 0x9e3779b97f4a7c15) >> shift);
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    size_t limit = 0;
+    size_t used = 0;
+    int shift = 64;
+};
@@ -0,0 +1,126 @@
+#pragma once
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Appends `value` to `out` as the contents of a JSON string. Paths and
+// commands may hold any byte: quotes, backslashes and control bytes are
+// escaped, and bytes that are not valid UTF-8 become \u00XX (their Latin-1
+// reading) so the document still parses. Runs of plain ASCII, the common
+// case, are found 16 bytes at a time and copied through in one append.
+
+namespace json_escape_detail {
+
+inline bool plain(unsigned char c) {
+    return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+// Length of the well-formed UTF-8 sequence at the front of [p, end), or 0.
+inline size_t utf8_length(const unsigned char* p, const unsigned char* end) {
+    size_t length = p[0] >= 0xf0 ? 4 : p[0] >= 0xe0 ? 3 : 2;
+    if (p[0] < 0xc2 || p[0] > 0xf4
+        || static_cast<size_t>(end - p) < length)
+        return 0;
+    uint32_t code = p[0] & (0x3f >> (length - 1));
+    for (size_t i = 1; i < length; i++) {
+        if ((p[i] & 0xc0) != 0x80) return 0;
+        code = code << 6 | (p[i] & 0x3f);
+    }
+    // Overlong forms and surrogates are not valid.
+    if ((length == 3 && code < 0x800) || (length == 4 && code < 0x10000)
+        || (code >= 0xd800 && code <= 0xdfff) || code > 0x10ffff)
+        return 0;
+    return length;
+}
+
+// Appends the byte at `p`, or the UTF-8 sequence it starts, in escaped form
+// and returns how many bytes it took.
+inline size_t append_escaped(std::string& out, const unsigned char* p,
+                             const unsigned char* end) {
+    static constexpr char hex[] = "0123456789abcdef";
+    switch (*p) {
+        case '"':
+            out += "\\\"";
+            return 1;
+        case '\\':
+            out += "\\\\";
+            return 1;
+        case '\n':
+            out += "\\n";
+            return 1;
+        case '\r':
+            out += "\\r";
+            return 1;
+        case '\t':
+            out += "\\t";
+            return 1;
+    }
+    if (*p >= 0x80) {
+        if (size_t length = utf8_length(p, end)) {
+            out.append(reinterpret_cast<const char*>(p), length);
+            return length;
+        }
+    }
+    char escape[6] = {'\\', 'u', '0', '0', hex[*p >> 4], hex[*p & 0xf]};
+    out.append(escape, sizeof(escape));
+    return 1;
+}
+
+}  // namespace json_escape_detail
+
+inline void append_json_escaped(std::string& out, std::string_view value) {
+    using namespace json_escape_detail;
+    const unsigned char* p
+        = reinterpret_cast<const unsigned char*>(value.data());
+    const unsigned char* end = p + value.size();
+    const unsigned char* plain_start = p;
+    while (p < end) {
+#if defined(__SSE2__)
+        if (end - p >= 16) {
+            __m128i block
+                = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            // Signed compare: bytes from 0x80 up are negative, so they are
+            // caught with the control bytes.
+            __m128i special = _mm_or_si128(
+                _mm_cmplt_epi8(block, _mm_set1_epi8(0x20)),
+                _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')),
+                             _mm_cmpeq_epi8(block, _mm_set1_epi8('\\'))));
+            int mask = _mm_movemask_epi8(special);
+            if (!mask) {
+                p += 16;
+                continue;
+            }
+            p += __builtin_ctz(mask);
+        }
+#endif
+        if (plain(*p)) {
+            p++;
+            continue;
+        }
+        out.append(reinterpret_cast<const char*>(plain_start),
+                   p - plain_start);
+        p += append_escaped(out, p, end);
+        plain_start = p;
+    }
+    out.append(reinterpret_cast<const char*>(plain_start), end - plain_start);
+}
+
+// Appends `value` as a quoted JSON string.
+inline void append_json_string(std::string& out, std::string_view value) {
+    out += '"';
+    append_json_escaped(out, value);
+    out += '"';
+}
+
+// `value` as a quoted JSON string.
+inline std::string json_string(std::string_view value) {
+    std::string out;
+    out.reserve(value.size() + 2);
+    append_json_string(out, value);
+    return out;
+}
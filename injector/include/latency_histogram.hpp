@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+#include "fixed_table.hpp"
+
+struct InternedPath;
+
+// Latency of the real I/O calls on one path, kept per thread and written out
+// once per process (PROV_LATENCY=1). Bucket b counts calls that took
+// [2^b, 2^(b+1)) monotonic ns; the last bucket also takes anything slower.
+
+inline constexpr int latency_buckets = 40;
+
+enum class IoKind : uint8_t { Read, Write, Sync };
+inline constexpr int io_kind_count = 3;
+inline constexpr const char* io_kind_names[io_kind_count] = {"read", "write",
+                                                             "sync"};
+
+struct LatencyHistogram {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t counts[latency_buckets] = {};
+
+    void add(uint64_t ns) {
+        int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+        counts[bucket < latency_buckets ? bucket : latency_buckets - 1]++;
+        calls++;
+        total_ns += ns;
+    }
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < latency_buckets; i++) counts[i] += other.counts[i];
+        calls += other.calls;
+        total_ns += other.total_ns;
+    }
+};
+
+struct PathLatency {
+    LatencyHistogram kinds[io_kind_count];
+};
+
+using PathLatencies = FixedTable<const InternedPath*, PathLatency,
+                                 std::hash<const InternedPath*>>;
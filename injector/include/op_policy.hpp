@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "control_page.hpp"
+#include "sysop.hpp"
+
+// Which op classes the injector records and how densely. PROV_OPS is a
+// comma-separated list of class names (sysop_names) to record, all of them
+// when unset. PROV_SAMPLE is a comma-separated list of class:first:every;
+// each thread keeps the first `first` events of the class and then one in
+// `every`. Process start and end are always recorded. Under prov exec the
+// recorded classes and an overall switch come from prov's control page
+// (PROV_CONTROL), so they can change while the process runs.
+struct OpSampling {
+    uint64_t first = 0;
+    uint64_t every = 0;  // 0 keeps every event
+};
+
+struct OpPolicy {
+    // control_enabled plus the recorded classes; `control` points here or
+    // into the mapped control page.
+    std::atomic<uint64_t> word{~uint64_t{0}};
+    const std::atomic<uint64_t>* control = &word;
+    bool sampled = false;  // some class has a sampling rate
+    OpSampling sampling[sysop_count];
+};
+
+extern OpPolicy op_policy;
+
+void load_op_policy();
+// Counts one event of a sampled class for this thread; true if it is kept.
+bool sample_op(SysOp op);
+
+// The gate in front of every event: once per hooked call, before anything is
+// looked up or formatted. Tracing switched off costs one load and a branch.
+static inline bool op_recorded(SysOp op) {
+    uint64_t need = control_enabled | uint64_t{1} << static_cast<uint8_t>(op);
+    if ((op_policy.control->load(std::memory_order_relaxed) & need) != need)
+        return false;
+    return !op_policy.sampled || sample_op(op);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <string_view>
+
+// Which paths the injector records. The filter is compiled on first use from
+// PROV_PATH_INCLUDE and PROV_PATH_EXCLUDE, colon-separated lists of absolute
+// prefixes; includes default to PROV_PATH_EXEC. The longest prefix matching
+// a path decides, prefixes only match whole components, and with no includes
+// everything not excluded is in scope. Relative and synthetic paths (pipes,
+// sockets, "fd=N") are always in scope.
+bool path_in_scope(std::string_view path);
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "fixed_table.hpp"
+#include "sysop.hpp"
+
+struct InternedPath;
+
+// What a process did to one path in one class of operation, kept in place of
+// the individual events in summary mode (PROV_SUMMARY=1) and written out in
+// SUMMARY records at exec and exit, or when a table fills up; the receiver
+// adds up those of one process. Transfers count on both of their paths.
+
+struct SummaryKey {
+    const InternedPath* path = nullptr;
+    SysOp op{};
+    bool output = false;  // written to, rather than read from
+
+    bool operator==(const SummaryKey&) const = default;
+};
+
+struct SummaryKeyHash {
+    size_t operator()(const SummaryKey& key) const {
+        size_t kind = static_cast<size_t>(key.op) << 1 | key.output;
+        return std::hash<const void*>()(key.path) ^ kind * 0x9e3779b97f4a7c15;
+    }
+};
+
+struct PathSummary {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t first_ts = 0;
+    uint64_t last_ts = 0;
+
+    void add(uint64_t ts, uint64_t moved) {
+        if (!count || ts < first_ts) first_ts = ts;
+        if (ts > last_ts) last_ts = ts;
+        count++;
+        bytes += moved;
+    }
+    void merge(const PathSummary& other) {
+        if (!other.count) return;
+        if (!count || other.first_ts < first_ts) first_ts = other.first_ts;
+        if (other.last_ts > last_ts) last_ts = other.last_ts;
+        count += other.count;
+        bytes += other.bytes;
+    }
+};
+
+using PathSummaries = FixedTable<SummaryKey, PathSummary, SummaryKeyHash>;
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// A path interned once per process. Entries and their bytes come from an
+// arena mapped once, so interning never calls malloc; they are never freed,
+// so pointers and ids stay valid for the process lifetime.
+//
+// Once the arena or the table is full, a path is recorded without interning:
+// it gets a short-lived entry of the calling thread with an id of its own,
+// which is overwritten a few lookups later. Callers keep pointers only to
+// interned entries.
+struct InternedPath {
+    uint32_t id;
+    uint64_t hash;
+    bool in_scope;  // path_in_scope(path), decided once
+    bool interned;
+    std::string_view path;
+};
+
+// Interned paths take ids below this, but for the few that a lost insert
+// race skips; paths recorded without interning take ids counting down from
+// the top of the range.
+inline constexpr uint32_t interned_path_limit = (1 << 16) + (1 << 12);
+
+const InternedPath* intern_path(std::string_view path);
+// Held across fork, so a child never inherits the table mid-insert.
+void lock_path_table();
+void unlock_path_table();
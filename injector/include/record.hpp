@@ -0,0 +1,303 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "sysop.hpp"
+
+// Every operation the injector records: enumerator, name used in the JSON
+// event stream and the class the receiver files it under.
+#define PROV_CALLS(X)                               \
+    X(Write, "WRITE", Write)                        \
+    X(Fwrite, "FWRITE", Write)                      \
+    X(Writev, "WRITEV", Writev)                     \
+    X(Pwrite, "PWRITE", Pwrite)                     \
+    X(Pwrite64, "PWRITE64", Pwrite)                 \
+    X(Fputs, "FPUTS", Write)                        \
+    X(Fprintf, "FPRINTF", Write)                    \
+    X(Vfprintf, "VFPRINTF", Write)                  \
+    X(Dprintf, "DPRINTF", Write)                    \
+    X(Vdprintf, "VDPRINTF", Write)                  \
+    X(Fputc, "FPUTC", Write)                        \
+    X(FputsUnlocked, "FPUTS_UNLOCKED", Write)       \
+    X(FwriteUnlocked, "FWRITE_UNLOCKED", Write)     \
+    X(Pwritev, "PWRITEV", Writev)                   \
+    X(Pwritev2, "PWRITEV2", Writev)                 \
+    X(Sendto, "SENDTO", NetSend)                    \
+    X(Sendmsg, "SENDMSG", NetSend)                  \
+    X(Sendmmsg, "SENDMMSG", NetSend)                \
+    X(Sendfile, "SENDFILE", Transfer)               \
+    X(Sendfile64, "SENDFILE64", Transfer)           \
+    X(CopyFileRange, "COPY_FILE_RANGE", Transfer)   \
+    X(Splice, "SPLICE", Transfer)                   \
+    X(Read, "READ", Read)                           \
+    X(Pread, "PREAD", Pread)                        \
+    X(Pread64, "PREAD64", Pread)                    \
+    X(Readv, "READV", Readv)                        \
+    X(Preadv, "PREADV", Readv)                      \
+    X(Preadv2, "PREADV2", Readv)                    \
+    X(Recvfrom, "RECVFROM", NetRecv)                \
+    X(Recvmsg, "RECVMSG", NetRecv)                  \
+    X(Recvmmsg, "RECVMMSG", NetRecv)                \
+    X(Getdents, "GETDENTS", Getdents)               \
+    X(Getdents64, "GETDENTS64", Getdents)           \
+    X(Execve, "EXECVE", Exec)                       \
+    X(ExecveFail, "EXECVE_FAIL", Unknown)           \
+    X(Execveat, "EXECVEAT", Exec)                   \
+    X(ExecveatFail, "EXECVEAT_FAIL", Unknown)       \
+    X(Fexecve, "FEXECVE", Exec)                     \
+    X(FexecveFail, "FEXECVE_FAIL", Unknown)         \
+    X(Execv, "EXECV", Exec)                         \
+    X(ExecvFail, "EXECV_FAIL", Unknown)             \
+    X(Execvp, "EXECPVP", Exec)                      \
+    X(ExecvpFail, "EXECPVP_FAIL", Unknown)          \
+    X(Execvpe, "EXECPVE", Exec)                     \
+    X(ExecvpeFail, "EXECPVE_FAIL", Unknown)         \
+    X(Execl, "EXECL", Exec)                         \
+    X(ExeclFail, "EXECL_FAIL", Unknown)             \
+    X(Execlp, "EXECLP", Exec)                       \
+    X(ExeclpFail, "EXECLP_FAIL", Unknown)           \
+    X(Execle, "EXECLE", Exec)                       \
+    X(ExecleFail, "EXECLE_FAIL", Unknown)           \
+    X(PosixSpawn, "POSIX_SPAWN", Spawn)             \
+    X(PosixSpawnp, "POSIX_SPAWNP", Spawn)           \
+    X(System, "SYSTEM", System)                     \
+    X(Fork, "FORK", Fork)                           \
+    X(Vfork, "VFORK", Fork)                         \
+    X(Clone, "CLONE", Fork)                         \
+    X(Rename, "RENAME", Rename)                     \
+    X(Renameat, "RENAMEAT", Rename)                 \
+    X(Renameat2, "RENAMEAT2", Rename)               \
+    X(Exit, "EXIT", Unknown)                        \
+    X(UnderscoreExit, "_EXIT", Unknown)             \
+    X(UnderscoreExitC, "_Exit", Unknown)            \
+    X(Open, "OPEN", Open)                           \
+    X(Open64, "OPEN64", Open)                       \
+    X(Creat, "CREAT", Open)                         \
+    X(Openat, "OPENAT", Open)                       \
+    X(Openat2, "OPENAT2", Open)                     \
+    X(Close, "CLOSE", Close)                        \
+    X(CloseRange, "CLOSE_RANGE", Close)             \
+    X(Fclose, "FCLOSE", Close)                      \
+    X(Pipe, "PIPE", Pipe)                           \
+    X(Pipe2, "PIPE2", Pipe)                         \
+    X(Dup, "DUP", Dup)                              \
+    X(Dup2, "DUP2", Dup)                            \
+    X(Dup3, "DUP3", Dup)                            \
+    X(Mmap, "MMAP", Unknown)                        \
+    X(Mmap64, "MMAP64", Unknown)                    \
+    X(Munmap, "MUNMAP", Unknown)                    \
+    X(Msync, "MSYNC", Msync)                        \
+    X(Ftruncate, "FTRUNCATE", Truncate)             \
+    X(Truncate, "TRUNCATE", Truncate)               \
+    X(PosixFadvise, "POSIX_FADVISE", Unknown)       \
+    X(PosixFallocate, "POSIX_FALLOCATE", Fallocate) \
+    X(Link, "LINK", Link)                           \
+    X(Linkat, "LINKAT", Link)                       \
+    X(Symlink, "SYMLINK", SymLink)                  \
+    X(Symlinkat, "SYMLINKAT", SymLink)              \
+    X(Unlink, "UNLINK", Unlink)                     \
+    X(Unlinkat, "UNLINKAT", Unlink)                 \
+    X(Remove, "REMOVE", Unlink)                     \
+    X(Rmdir, "RMDIR", Unlink)                       \
+    X(ShmUnlink, "SHM_UNLINK", Unlink)              \
+    X(MqUnlink, "MQ_UNLINK", Unlink)                \
+    X(SemUnlink, "SEM_UNLINK", Unlink)              \
+    X(StartProcess, "START_PROCESS", ProcessStart)  \
+    X(EndProcess, "END_PROCESS", ProcessEnd)        \
+    X(PathDef, "PATH_DEF", Unknown)                 \
+    X(Dropped, "DROPPED", Unknown)                  \
+    X(ClockAnchor, "CLOCK_ANCHOR", Unknown)         \
+    X(Overhead, "OVERHEAD", Unknown)                \
+    X(FileDigest, "FILE_DIGEST", Unknown)           \
+    X(Latency, "LATENCY", Unknown)                  \
+    X(Summary, "SUMMARY", Unknown)
+
+enum class Call : uint16_t {
+#define PROV_CALL_ENUM(id, name, op) id,
+    PROV_CALLS(PROV_CALL_ENUM)
+#undef PROV_CALL_ENUM
+    Count
+};
+
+struct CallInfo {
+    const char* name;
+    SysOp op;
+};
+
+inline constexpr CallInfo call_table[] = {
+#define PROV_CALL_INFO(id, name, op) {name, SysOp::op},
+    PROV_CALLS(PROV_CALL_INFO)
+#undef PROV_CALL_INFO
+};
+
+constexpr const char* call_name(Call call) {
+    return call_table[static_cast<uint16_t>(call)].name;
+}
+
+constexpr SysOp call_op(Call call) {
+    return call_table[static_cast<uint16_t>(call)].op;
+}
+
+// Binary spool format (PROV_FORMAT=binary). A file starts with a
+// RecordFileHeader followed by records of the form
+//   RecordHeader | payload
+// where the payload is the sequence of fields given by the layout. Integers
+// are u64 in host byte order, strings a u16 length followed by the bytes.
+// Paths are u32 ids; each thread's stream carries a PathDef record for an id
+// before the first record that uses it.
+enum class RecordLayout : uint8_t {
+    Empty,
+    PathIn,          // path_in
+    PathOut,         // path_out
+    PathInOut,       // path_in, path_out
+    Path,            // path
+    PathError,       // path, error
+    ChildPid,        // child_pid
+    ChildPidPath,    // child_pid, path
+    Net,             // fd, count, sockaddr (raw bytes, empty if none)
+    ProcessStart,    // ppid
+    PathDef,         // id (u32), path (string)
+    PathInRun,       // path_in, count, bytes, ts_end
+    PathOutRun,      // path_out, count, bytes, ts_end
+    Dropped,         // events
+    ClockAnchor,     // clock, wall_ns; the header ts is the raw reading
+    Overhead,        // events, dropped, hooks, then hooks x (call, calls, ns)
+    FileDigest,      // path, bytes, hashed, xxh3_high, xxh3_low
+    PathInBytes,     // path_in, bytes
+    PathOutBytes,    // path_out, bytes
+    PathInOutBytes,  // path_in, path_out, bytes
+    Latency,         // path, io kind, calls, total_ns, buckets, then
+                     // buckets x (bucket, count)
+    Summary,         // entries, then entries x (path, op, output, count,
+                     // bytes, first_ts, last_ts)
+};
+
+inline constexpr char record_magic[8] = {'P', 'R', 'O', 'V', 'R', 'E', 'C', 0};
+// Bumped with every new or changed layout; prov skips spools of any other
+// version rather than misread them.
+inline constexpr uint32_t record_version = 8;
+
+struct RecordFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct RecordHeader {
+    uint32_t size;  // header plus payload
+    uint16_t call;
+    uint8_t op;
+    uint8_t layout;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t ts;
+};
+static_assert(sizeof(RecordHeader) == 24);
+
+// Socket addresses travel as raw sockaddr bytes, hex-encoded in JSON; the
+// receiver formats them.
+inline void append_hex(std::string& out, std::string_view bytes) {
+    static constexpr char digits[] = "0123456789abcdef";
+    for (unsigned char byte : bytes) {
+        out += digits[byte >> 4];
+        out += digits[byte & 0xf];
+    }
+}
+
+inline RecordFileHeader record_file_header() {
+    RecordFileHeader header{};
+    std::memcpy(header.magic, record_magic, sizeof(record_magic));
+    header.version = record_version;
+    return header;
+}
+
+// Appends one record to `out`; the size is patched in on destruction.
+class RecordWriter {
+   public:
+    RecordWriter(std::string& out, Call call, RecordLayout layout, uint32_t pid,
+                 uint32_t tid, uint64_t ts)
+        : out(out), start(out.size()) {
+        RecordHeader header{.size = 0,
+                            .call = static_cast<uint16_t>(call),
+                            .op = static_cast<uint8_t>(call_op(call)),
+                            .layout = static_cast<uint8_t>(layout),
+                            .pid = pid,
+                            .tid = tid,
+                            .ts = ts};
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    ~RecordWriter() {
+        uint32_t size = static_cast<uint32_t>(out.size() - start);
+        std::memcpy(out.data() + start, &size, sizeof(size));
+    }
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    void u32(uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void u64(uint64_t value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void str(std::string_view value) {
+        uint16_t size = static_cast<uint16_t>(
+            value.size() > UINT16_MAX ? UINT16_MAX : value.size());
+        out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.append(value.data(), size);
+    }
+
+   private:
+    std::string& out;
+    size_t start;
+};
+
+// Reads the fields of one record payload in order. Reads past the end of the
+// payload yield zeros and empty strings.
+class RecordReader {
+   public:
+    RecordReader(const char* pos, const char* end) : pos(pos), end(end) {
+    }
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(value))) return 0;
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    uint64_t u64() {
+        uint64_t value = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(value))) return 0;
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    std::string_view str() {
+        uint16_t size = 0;
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(size))) return {};
+        std::memcpy(&size, pos, sizeof(size));
+        pos += sizeof(size);
+        if (end - pos < size) size = static_cast<uint16_t>(end - pos);
+        std::string_view value(pos, size);
+        pos += size;
+        return value;
+    }
+
+   private:
+    const char* pos;
+    const char* end;
+};
+
+// Splits the next complete record off [pos, end). Returns false at the end of
+// the data or on a truncated record.
+inline bool next_record(const char*& pos, const char* end,
+                        RecordHeader& header, RecordReader& payload) {
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(RecordHeader))) return false;
+    std::memcpy(&header, pos, sizeof(header));
+    if (header.size < sizeof(RecordHeader) || header.size > end - pos)
+        return false;
+    payload = RecordReader(pos + sizeof(RecordHeader), pos + header.size);
+    pos += header.size;
+    return true;
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// One spool shared by every process of a prov exec (PROV_SPOOL=shared), so a
+// step that forks thousands of short-lived processes leaves one file rather
+// than one per process or thread. prov creates the file at its full size
+// (sparse, so only written pages take memory) and reads it once the command
+// is done, front to back.
+//
+// Writers reserve space with a fetch-add on `reserved` and never reuse it. A
+// chunk is a SharedChunk followed by `size` bytes of whole events in the
+// run's format, or one compressed chunk of them (spool_chunk.hpp), padded to
+// shared_align. `size` and `pid` are written right after the reservation and
+// `ready` last, so a chunk whose writer was killed is skipped by its size, or
+// by scanning for the next ready chunk if even that never got written.
+//
+// A thread can instead open a chunk with room for `capacity` bytes and
+// commit events into it one at a time: it is ready from the start, and
+// `size` is raised after each copy, so only whole events are ever read.
+
+inline constexpr char shared_spool_magic[8] = {'P', 'R', 'O', 'V',
+                                               'S', 'H', 'R', 'D'};
+inline constexpr uint64_t shared_align = 16;
+inline constexpr uint32_t shared_chunk_ready = 0x59444452;  // "RDDY"
+
+struct SharedSpoolHeader {
+    char magic[8];
+    uint32_t version;     // record_version
+    uint16_t binary;      // 1 for binary records, 0 for JSON lines
+    uint16_t compressed;  // 1 if each chunk holds one compressed chunk
+    uint64_t capacity;    // bytes in the data area, a multiple of shared_align
+    alignas(64) std::atomic<uint64_t> reserved;  // bytes handed out so far
+};
+
+struct SharedChunk {
+    std::atomic<uint32_t> ready;  // shared_chunk_ready once the data is in
+    std::atomic<uint32_t> size;
+    uint32_t pid;
+    uint32_t capacity;  // room for data in an open chunk, 0 if written whole
+};
+static_assert(sizeof(SharedChunk) == shared_align);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+inline char* shared_spool_data(SharedSpoolHeader* spool) {
+    return reinterpret_cast<char*>(spool) + sizeof(SharedSpoolHeader);
+}
+
+inline const char* shared_spool_data(const SharedSpoolHeader* spool) {
+    return reinterpret_cast<const char*>(spool) + sizeof(SharedSpoolHeader);
+}
+
+inline size_t shared_spool_size(uint64_t capacity) {
+    return sizeof(SharedSpoolHeader) + capacity;
+}
+
+// Bytes a chunk with `size` bytes of data takes up in the spool.
+inline uint64_t shared_chunk_span(uint64_t size) {
+    return (sizeof(SharedChunk) + size + shared_align - 1)
+           & ~(shared_align - 1);
+}
+
+// Reserves `need` bytes, or returns nullptr once the spool is full. A full
+// spool is only read, so writers that keep trying do not contend on it.
+inline SharedChunk* shared_spool_reserve(SharedSpoolHeader* spool,
+                                         uint64_t need) {
+    if (need > spool->capacity
+        || spool->reserved.load(std::memory_order_relaxed) + need
+               > spool->capacity)
+        return nullptr;
+    uint64_t offset
+        = spool->reserved.fetch_add(need, std::memory_order_relaxed);
+    if (offset + need > spool->capacity) return nullptr;
+    return reinterpret_cast<SharedChunk*>(shared_spool_data(spool) + offset);
+}
+
+// Fills in the header of a freshly created, zero-filled shared spool.
+inline void init_shared_spool(SharedSpoolHeader* spool, uint64_t capacity,
+                              uint32_t version, bool binary, bool compressed) {
+    std::memcpy(spool->magic, shared_spool_magic, sizeof(shared_spool_magic));
+    spool->version = version;
+    spool->binary = binary;
+    spool->compressed = compressed;
+    spool->capacity = capacity & ~(shared_align - 1);
+    spool->reserved.store(0);
+}
+
+// Appends one chunk. Returns false once the spool is full; the caller then
+// writes the data elsewhere.
+inline bool shared_spool_write(SharedSpoolHeader* spool, uint32_t pid,
+                               const char* data, size_t size) {
+    SharedChunk* chunk = shared_spool_reserve(spool, shared_chunk_span(size));
+    if (!chunk) return false;
+    chunk->size.store(static_cast<uint32_t>(size), std::memory_order_relaxed);
+    chunk->pid = pid;
+    std::memcpy(static_cast<void*>(chunk + 1), data, size);
+    chunk->ready.store(shared_chunk_ready, std::memory_order_release);
+    return true;
+}
+
+// Opens a chunk with room for `capacity` bytes that events are committed to
+// with shared_chunk_append. Returns nullptr once the spool is full.
+inline SharedChunk* shared_chunk_open(SharedSpoolHeader* spool, uint32_t pid,
+                                      size_t capacity) {
+    if (capacity > UINT32_MAX) return nullptr;
+    SharedChunk* chunk
+        = shared_spool_reserve(spool, shared_chunk_span(capacity));
+    if (!chunk) return nullptr;
+    chunk->pid = pid;
+    chunk->capacity = static_cast<uint32_t>(capacity);
+    chunk->ready.store(shared_chunk_ready, std::memory_order_release);
+    return chunk;
+}
+
+// Copies whole events into an open chunk's free room. Returns false, copying
+// nothing, when they do not fit.
+inline bool shared_chunk_append(SharedChunk* chunk, const char* data,
+                                size_t size) {
+    uint32_t used = chunk->size.load(std::memory_order_relaxed);
+    if (size > chunk->capacity - used) return false;
+    std::memcpy(reinterpret_cast<char*>(chunk + 1) + used, data, size);
+    chunk->size.store(used + static_cast<uint32_t>(size),
+                      std::memory_order_release);
+    return true;
+}
+
+// Hands every written chunk, in file order, to `consume(pid, data, size)`.
+// Meant for after the writers are gone: a chunk that is not ready was
+// abandoned and is skipped.
+template <class Consume>
+inline void shared_spool_read(const SharedSpoolHeader* spool,
+                              Consume&& consume) {
+    uint64_t end = spool->reserved.load(std::memory_order_acquire);
+    if (end > spool->capacity) end = spool->capacity;
+    const char* base = shared_spool_data(spool);
+    uint64_t offset = 0;
+    while (end - offset >= sizeof(SharedChunk)) {
+        const SharedChunk* chunk
+            = reinterpret_cast<const SharedChunk*>(base + offset);
+        bool ready = chunk->ready.load(std::memory_order_acquire)
+                     == shared_chunk_ready;
+        uint32_t size = chunk->size.load(std::memory_order_acquire);
+        uint64_t span = shared_chunk_span(chunk->capacity ? chunk->capacity
+                                                          : size);
+        if (ready && span <= end - offset) {
+            size_t data_size = chunk->capacity
+                                   ? std::min(size, chunk->capacity)
+                                   : size;
+            if (data_size)
+                consume(chunk->pid, reinterpret_cast<const char*>(chunk + 1),
+                        data_size);
+            offset += span;
+        } else if (!ready && (size || chunk->capacity)
+                   && span <= end - offset) {
+            offset += span;
+        } else {
+            offset += shared_align;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Shared-memory ring that traced processes append event chunks to while prov
+// drains it (PROV_RING). prov creates and sizes the ring; any number of
+// threads in any number of processes may write, prov is the only reader.
+//
+// A chunk is a RingChunk followed by `size` bytes of whole events in the
+// spool format, padded to ring_align. Chunks never wrap: a writer that
+// reaches the end of the data area first fills the rest with a padding chunk
+// (pid 0). `ready` is set last, so the reader stops at the first chunk that
+// is reserved but not yet written. The reader zeroes what it consumed, which
+// keeps `ready` clear in every chunk a writer reserves later.
+
+inline constexpr char ring_magic[8] = {'P', 'R', 'O', 'V', 'R', 'I', 'N', 'G'};
+inline constexpr uint64_t ring_align = 16;
+
+struct RingHeader {
+    char magic[8];
+    uint64_t capacity;  // bytes in the data area, a multiple of ring_align
+    uint32_t version;   // record_version of the chunks prov can decode
+    alignas(64) std::atomic<uint64_t> head;  // total bytes reserved
+    alignas(64) std::atomic<uint64_t> tail;  // total bytes consumed
+};
+
+struct RingChunk {
+    std::atomic<uint32_t> ready;
+    uint32_t size;
+    uint32_t pid;
+    uint32_t reserved;
+};
+static_assert(sizeof(RingChunk) == ring_align);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+inline char* ring_data(RingHeader* ring) {
+    return reinterpret_cast<char*>(ring) + sizeof(RingHeader);
+}
+
+inline size_t ring_mapping_size(uint64_t capacity) {
+    return sizeof(RingHeader) + capacity;
+}
+
+// Sets up a freshly mapped, zero-filled ring.
+inline void init_ring(RingHeader* ring, uint64_t capacity, uint32_t version) {
+    std::memcpy(ring->magic, ring_magic, sizeof(ring_magic));
+    ring->capacity = capacity & ~(ring_align - 1);
+    ring->version = version;
+    ring->head.store(0);
+    ring->tail.store(0);
+}
+
+// Appends one chunk. Returns false when the ring has no room for it; the
+// caller then keeps the data or writes it elsewhere.
+inline bool ring_write(RingHeader* ring, uint32_t pid, const char* data,
+                       size_t size) {
+    uint64_t capacity = ring->capacity;
+    uint64_t need = (sizeof(RingChunk) + size + ring_align - 1)
+                    & ~(ring_align - 1);
+    if (need > capacity / 2) return false;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t pad;
+    do {
+        uint64_t to_end = capacity - head % capacity;
+        pad = need <= to_end ? 0 : to_end;
+        if (head + pad + need - ring->tail.load(std::memory_order_acquire)
+            > capacity)
+            return false;
+    } while (!ring->head.compare_exchange_weak(head, head + pad + need));
+    char* base = ring_data(ring);
+    if (pad) {
+        RingChunk* filler
+            = reinterpret_cast<RingChunk*>(base + head % capacity);
+        filler->size = static_cast<uint32_t>(pad - sizeof(RingChunk));
+        filler->pid = 0;
+        filler->ready.store(1, std::memory_order_release);
+        head += pad;
+    }
+    RingChunk* chunk = reinterpret_cast<RingChunk*>(base + head % capacity);
+    chunk->size = static_cast<uint32_t>(size);
+    chunk->pid = pid;
+    std::memcpy(static_cast<void*>(chunk + 1), data, size);
+    chunk->ready.store(1, std::memory_order_release);
+    return true;
+}
+
+// Hands every written chunk, in ring order, to `consume(pid, data, size)`
+// and releases its space. Stops early at a chunk still being written.
+// Returns the number of bytes released.
+template <class Consume>
+inline uint64_t ring_drain(RingHeader* ring, Consume&& consume) {
+    uint64_t capacity = ring->capacity;
+    char* base = ring_data(ring);
+    uint64_t start = ring->tail.load(std::memory_order_relaxed);
+    uint64_t tail = start;
+    while (tail != ring->head.load(std::memory_order_acquire)) {
+        RingChunk* chunk = reinterpret_cast<RingChunk*>(base + tail % capacity);
+        if (!chunk->ready.load(std::memory_order_acquire)) break;
+        uint64_t span = (sizeof(RingChunk) + chunk->size + ring_align - 1)
+                        & ~(ring_align - 1);
+        if (chunk->pid)
+            consume(chunk->pid, reinterpret_cast<const char*>(chunk + 1),
+                    static_cast<size_t>(chunk->size));
+        std::memset(static_cast<void*>(chunk), 0, span);
+        tail += span;
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    return tail - start;
+}
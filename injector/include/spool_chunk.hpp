@@ -0,0 +1,74 @@
+#pragma once
+#include <lz4.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Compressed spool output (PROV_COMPRESS=lz4). The events of a spool file are
+// then a sequence of chunks, each a ChunkHeader and one LZ4 block that
+// decodes to whole events in the run's format. A chunk LZ4 cannot shrink is
+// stored as is, with packed_size 0.
+
+inline constexpr uint32_t chunk_magic = 0x4b4e4843;  // "CHNK"
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t raw_size;
+    uint32_t packed_size;  // 0 when the raw bytes are stored
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkHeader) == 16);
+
+// Appends [data, data + size) to `out` as one chunk. `state` is scratch
+// space of LZ4_sizeofState() bytes, aligned for pointers. Returns false for
+// data too large for one chunk.
+inline bool append_chunk(std::string& out, const char* data, size_t size,
+                         void* state) {
+    if (size > LZ4_MAX_INPUT_SIZE) return false;
+    size_t start = out.size();
+    out.resize(start + sizeof(ChunkHeader) + size);
+    char* block = out.data() + start + sizeof(ChunkHeader);
+    int raw_size = static_cast<int>(size);
+    int packed_size = LZ4_compress_fast_extState(state, data, block, raw_size,
+                                                 raw_size, 1);
+    if (packed_size <= 0) {
+        std::memcpy(block, data, size);
+        packed_size = 0;
+    }
+    ChunkHeader header{.magic = chunk_magic,
+                       .raw_size = static_cast<uint32_t>(raw_size),
+                       .packed_size = static_cast<uint32_t>(packed_size),
+                       .reserved = 0};
+    std::memcpy(out.data() + start, &header, sizeof(header));
+    out.resize(start + sizeof(ChunkHeader)
+               + (packed_size ? static_cast<size_t>(packed_size) : size));
+    return true;
+}
+
+// Decodes the chunk at the front of [pos, end) into `raw`, reusing its
+// storage, and moves past it. Returns false at the end of the data or on a
+// truncated or corrupt chunk.
+inline bool next_chunk(const char*& pos, const char* end, std::string& raw) {
+    ChunkHeader header;
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(header))) return false;
+    std::memcpy(&header, pos, sizeof(header));
+    size_t block_size = header.packed_size ? header.packed_size
+                                           : header.raw_size;
+    if (header.magic != chunk_magic
+        || header.raw_size > LZ4_MAX_INPUT_SIZE
+        || block_size > static_cast<size_t>(end - pos) - sizeof(header))
+        return false;
+    const char* block = pos + sizeof(header);
+    raw.resize(header.raw_size);
+    if (!header.packed_size) {
+        std::memcpy(raw.data(), block, header.raw_size);
+    } else if (LZ4_decompress_safe(block, raw.data(),
+                                   static_cast<int>(header.packed_size),
+                                   static_cast<int>(header.raw_size))
+               != static_cast<int>(header.raw_size)) {
+        return false;
+    }
+    pos = block + block_size;
+    return true;
+}
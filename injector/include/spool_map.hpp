@@ -0,0 +1,45 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Per-thread spool file the injector maps and commits events to as they are
+// recorded (PROV_SPOOL=mmap), so the kernel keeps them however the process
+// ends: exec, _exit or a kill. A SpoolHeader is followed by events in the
+// run's spool format, or by compressed chunks of them (spool_chunk.hpp).
+// Whole events are copied in before `committed` moves past them, so prov
+// reads only complete records.
+
+inline constexpr char spool_magic[8] = {'P', 'R', 'O', 'V', 'S', 'P', 'O', 'L'};
+
+struct SpoolHeader {
+    char magic[8];
+    uint32_t version;  // record_version
+    uint16_t binary;      // 1 for binary records, 0 for JSON lines
+    uint16_t compressed;  // 1 if the events are in compressed chunks
+    uint32_t pid;
+    uint32_t tid;
+    std::atomic<uint64_t> committed;  // bytes of whole events after the header
+};
+static_assert(sizeof(SpoolHeader) == 32);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+inline char* spool_data(SpoolHeader* spool) {
+    return reinterpret_cast<char*>(spool) + sizeof(SpoolHeader);
+}
+
+inline const char* spool_data(const SpoolHeader* spool) {
+    return reinterpret_cast<const char*>(spool) + sizeof(SpoolHeader);
+}
+
+// Fills in the header of a freshly created, zero-filled spool.
+inline void init_spool(SpoolHeader* spool, uint32_t version, bool binary,
+                       bool compressed, uint32_t pid, uint32_t tid) {
+    std::memcpy(spool->magic, spool_magic, sizeof(spool_magic));
+    spool->version = version;
+    spool->binary = binary;
+    spool->compressed = compressed;
+    spool->pid = pid;
+    spool->tid = tid;
+    spool->committed.store(0);
+}
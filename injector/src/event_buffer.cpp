@@ -0,0 +1,212 @@
+#include "event_buffer.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "path_table.hpp"
+#include "spool_map.hpp"
+
+thread_local ThreadBuffer* local_thread_buffer = nullptr;
+std::atomic<bool> events_flushing{false};
+BufferLimits buffer_limits;
+
+// Buffers of exited threads stay registered until the flush.
+static std::atomic<ThreadBuffer*> thread_buffers{nullptr};
+
+// Room beyond the flush threshold for the event that crosses it.
+static constexpr size_t flush_headroom = size_t{64} << 10;
+
+ThreadBuffer* register_thread_buffer() {
+    ThreadBuffer* buffer = new ThreadBuffer();
+    // Reserved up front, so a streaming buffer is never grown by the events
+    // recorded into it.
+    size_t reserve = buffer_limits.flush_bytes;
+    if (buffer_limits.cap_bytes && buffer_limits.cap_bytes < reserve)
+        reserve = buffer_limits.cap_bytes;
+    buffer->data.reserve(reserve + flush_headroom);
+    buffer->defined_paths.resize(interned_path_limit / 64);
+    if (buffer_limits.latency_paths)
+        buffer->latencies.reserve(buffer_limits.latency_paths);
+    if (buffer_limits.summary_paths)
+        buffer->summaries.reserve(buffer_limits.summary_paths);
+    buffer->tid = static_cast<pid_t>(syscall(SYS_gettid));
+    buffer->next = thread_buffers.load(std::memory_order_relaxed);
+    while (!thread_buffers.compare_exchange_weak(buffer->next, buffer)) {
+    }
+    local_thread_buffer = buffer;
+    return buffer;
+}
+
+bool reserve_thread_buffer(ThreadBuffer* buffer) {
+    size_t cap = buffer_limits.cap_bytes;
+    if (!cap || buffer->data.size() < cap) return true;
+    if (buffer_limits.drop_policy == DropPolicy::Newest) {
+        buffer->dropped_events++;
+        return false;
+    }
+    buffer->dropped_events += buffer->buffered_events;
+    buffer->buffered_events = 0;
+    buffer->data.clear();
+    // The dropped data may have held path definitions.
+    forget_defined_paths(buffer);
+    return true;
+}
+
+void clear_thread_buffer(ThreadBuffer* buffer) {
+    // clear() keeps the capacity, so a streaming buffer settles at one
+    // allocation.
+    buffer->data.clear();
+    buffer->buffered_events = 0;
+    forget_defined_paths(buffer);
+}
+
+void forget_defined_paths(ThreadBuffer* buffer) {
+    std::fill(buffer->defined_paths.begin(), buffer->defined_paths.end(), 0);
+}
+
+// Returns how much of the data was written.
+static size_t write_fully(int fd, const char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t written = syscall(SYS_write, fd, data + done, size - done);
+        if (written <= 0) break;
+        done += static_cast<size_t>(written);
+    }
+    return done;
+}
+
+bool write_thread_buffer(int fd, ThreadBuffer* buffer) {
+    size_t size = buffer->data.size();
+    size_t done = write_fully(fd, buffer->data.data(), size);
+    if (done == size) {
+        clear_thread_buffer(buffer);
+        return true;
+    }
+    buffer->data.erase(0, done);
+    return false;
+}
+
+bool write_thread_chunk(int fd, ThreadBuffer* buffer,
+                        const std::string& chunk) {
+    struct stat st;
+    if (syscall(SYS_fstat, fd, &st) != 0) return false;
+    if (write_fully(fd, chunk.data(), chunk.size()) != chunk.size()) {
+        syscall(SYS_ftruncate, fd, st.st_size);
+        return false;
+    }
+    clear_thread_buffer(buffer);
+    return true;
+}
+
+void flush_thread_buffers(void (*flush)(ThreadBuffer*)) {
+    events_flushing.store(true);
+    for (ThreadBuffer* buffer = thread_buffers.load(); buffer;
+         buffer = buffer->next) {
+        while (buffer->writing.load()) {
+        }
+        flush(buffer);
+    }
+}
+
+bool checkpoint_thread_buffers(void (*flush)(ThreadBuffer*),
+                               void (*finish)()) {
+    bool flushing = false;
+    if (!events_flushing.compare_exchange_strong(flushing, true)) return false;
+    for (ThreadBuffer* buffer = thread_buffers.load(); buffer;
+         buffer = buffer->next) {
+        while (buffer->writing.load()) {
+        }
+        flush(buffer);
+    }
+    finish();
+    events_flushing.store(false);
+    return true;
+}
+
+// The first mapping is sparse on tmpfs; it doubles whenever it fills up.
+static constexpr size_t spool_initial_bytes = size_t{1} << 20;
+static constexpr size_t page_bytes = 4096;
+
+// Raw syscalls throughout, as libc's open/mmap are hooked by the injector.
+bool map_thread_spool(ThreadBuffer* buffer, const std::string& path,
+                      uint32_t pid, bool binary, bool compressed) {
+    buffer->spool_path = path;
+    int fd = syscall(SYS_open, path.c_str(),
+                     O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    void* map = MAP_FAILED;
+    if (syscall(SYS_ftruncate, fd, spool_initial_bytes) == 0)
+        map = reinterpret_cast<void*>(
+            syscall(SYS_mmap, nullptr, spool_initial_bytes,
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    syscall(SYS_close, fd);
+    if (map == MAP_FAILED) return false;
+    buffer->spool = static_cast<SpoolHeader*>(map);
+    buffer->spool_size = spool_initial_bytes;
+    init_spool(buffer->spool, record_version, binary, compressed, pid,
+               static_cast<uint32_t>(buffer->tid));
+    return true;
+}
+
+static bool grow_thread_spool(ThreadBuffer* buffer, size_t need) {
+    size_t size = buffer->spool_size;
+    while (size < need) size *= 2;
+    if (syscall(SYS_truncate, buffer->spool_path.c_str(), size) != 0)
+        return false;
+    void* map = reinterpret_cast<void*>(syscall(SYS_mremap, buffer->spool,
+                                                buffer->spool_size, size,
+                                                MREMAP_MAYMOVE));
+    if (map == MAP_FAILED) return false;
+    buffer->spool = static_cast<SpoolHeader*>(map);
+    buffer->spool_size = size;
+    return true;
+}
+
+bool commit_thread_buffer(ThreadBuffer* buffer) {
+    return commit_thread_chunk(buffer, buffer->data);
+}
+
+bool commit_thread_chunk(ThreadBuffer* buffer, const std::string& chunk) {
+    size_t size = chunk.size();
+    uint64_t committed
+        = buffer->spool->committed.load(std::memory_order_relaxed);
+    size_t need = sizeof(SpoolHeader) + committed + size;
+    if (need > buffer->spool_size && !grow_thread_spool(buffer, need))
+        return false;
+    std::memcpy(spool_data(buffer->spool) + committed, chunk.data(), size);
+    buffer->spool->committed.store(committed + size,
+                                   std::memory_order_release);
+    // Unmap each committed MiB behind the writer. The file keeps the pages,
+    // but they no longer count towards the process's resident set.
+    size_t done = (sizeof(SpoolHeader) + committed + size)
+                  & ~(spool_initial_bytes - 1);
+    if (done > sizeof(SpoolHeader) + committed) {
+        size_t start = done > spool_initial_bytes ? done - spool_initial_bytes
+                                                  : page_bytes;
+        char* base = reinterpret_cast<char*>(buffer->spool);
+        syscall(SYS_madvise, base + start, done - start, MADV_DONTNEED);
+    }
+    buffer->data.clear();
+    buffer->buffered_events = 0;
+    return true;
+}
+
+void reset_thread_buffers_after_fork() {
+    ThreadBuffer* buffer = thread_buffers.exchange(nullptr);
+    while (buffer) {
+        ThreadBuffer* next = buffer->next;
+        // The parent keeps writing to the file behind an inherited mapping.
+        if (buffer->spool)
+            syscall(SYS_munmap, buffer->spool, buffer->spool_size);
+        delete buffer;
+        buffer = next;
+    }
+    local_thread_buffer = nullptr;
+    events_flushing.store(false);
+}
@@ -0,0 +1,126 @@
+#include "fd_table.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+
+static constexpr int fd_table_size = 65536;
+
+static std::atomic<const InternedPath*> fd_paths[fd_table_size];
+// One bit per descriptor of a skipped kind.
+static std::atomic<uint64_t> skipped_fds[fd_table_size / 64];
+
+enum FdKind : uint8_t {
+    FdOther = 0,
+    FdPipe = 1 << 0,
+    FdSocket = 1 << 1,
+    FdChar = 1 << 2,  // terminals, /dev/null and other character devices
+    FdAnon = 1 << 3,  // anonymous inodes: eventfd, epoll, timerfd, signalfd
+};
+
+static uint8_t skipped_kinds = FdPipe | FdSocket | FdChar | FdAnon;
+
+static bool in_table(int fd) {
+    return fd >= 0 && fd < fd_table_size;
+}
+
+static uint8_t fd_kind(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) return FdOther;
+    switch (st.st_mode & S_IFMT) {
+        case S_IFIFO:
+            return FdPipe;
+        case S_IFSOCK:
+            return FdSocket;
+        case S_IFCHR:
+            return FdChar;
+        case 0:
+            return FdAnon;
+        default:
+            return FdOther;
+    }
+}
+
+static void set_skipped(int fd, bool skipped) {
+    uint64_t bit = uint64_t{1} << (fd % 64);
+    if (skipped)
+        skipped_fds[fd / 64].fetch_or(bit, std::memory_order_relaxed);
+    else
+        skipped_fds[fd / 64].fetch_and(~bit, std::memory_order_relaxed);
+}
+
+void load_fd_policy() {
+    const char* kinds = std::getenv("PROV_SKIP_FDS");
+    if (!kinds || !*kinds) return;
+    skipped_kinds = FdOther;
+    std::string_view rest = kinds;
+    while (!rest.empty()) {
+        size_t end = rest.find(',');
+        std::string_view kind = rest.substr(0, end);
+        if (kind == "pipe") skipped_kinds |= FdPipe;
+        if (kind == "socket") skipped_kinds |= FdSocket;
+        if (kind == "char") skipped_kinds |= FdChar;
+        if (kind == "anon") skipped_kinds |= FdAnon;
+        rest.remove_prefix(end == std::string_view::npos ? rest.size()
+                                                         : end + 1);
+    }
+}
+
+void remember_fd(int fd) {
+    if (!in_table(fd)) return;
+    // Skipped descriptors are never resolved, so they cost no readlink.
+    bool skipped = fd_kind(fd) & skipped_kinds;
+    set_skipped(fd, skipped);
+    if (skipped) {
+        fd_paths[fd].store(nullptr, std::memory_order_relaxed);
+        return;
+    }
+    char link[64];
+    std::snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    std::array<char, 256> buf{};
+    ssize_t r = ::readlink(link, buf.data(), buf.size() - 1);
+    if (r < 0) {
+        forget_fd(fd);
+        return;
+    }
+    // A path recorded without interning is looked up again on every use.
+    const InternedPath* path = intern_path(std::string_view(buf.data(), r));
+    fd_paths[fd].store(path->interned ? path : nullptr,
+                       std::memory_order_release);
+}
+
+void forget_fd(int fd) {
+    if (!in_table(fd)) return;
+    fd_paths[fd].store(nullptr, std::memory_order_relaxed);
+    set_skipped(fd, false);
+}
+
+void forget_fd_range(unsigned int first, unsigned int last) {
+    for (unsigned int fd = first; fd <= last && fd < fd_table_size; ++fd) {
+        fd_paths[fd].store(nullptr, std::memory_order_relaxed);
+        set_skipped(fd, false);
+    }
+}
+
+void copy_fd(int oldfd, int newfd) {
+    if (!in_table(newfd)) return;
+    const InternedPath* path = lookup_fd(oldfd);
+    fd_paths[newfd].store(path, std::memory_order_release);
+    set_skipped(newfd, fd_skipped(oldfd));
+}
+
+const InternedPath* lookup_fd(int fd) {
+    if (!in_table(fd)) return nullptr;
+    return fd_paths[fd].load(std::memory_order_acquire);
+}
+
+bool fd_skipped(int fd) {
+    if (!in_table(fd)) return false;
+    return skipped_fds[fd / 64].load(std::memory_order_relaxed) >> (fd % 64)
+           & 1;
+}
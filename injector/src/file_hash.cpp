@@ -0,0 +1,185 @@
+#include "file_hash.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <xxhash.h>
+
+#include <atomic>
+#include <mutex>
+
+bool file_hashing = false;
+
+static constexpr int fd_table_size = 65536;
+
+// State of one open file description, shared by the fds dup'd from it.
+struct FileHash {
+    std::mutex mutex;
+    std::atomic<int> refs{1};
+    XXH3_state_t* state = nullptr;  // null once the content is not followed
+    bool append = false;            // O_APPEND: every write lands at the end
+    bool written = false;
+    uint64_t bytes = 0;     // written so far, the end of the hashed content
+    uint64_t position = 0;  // file position of write()
+};
+
+static std::atomic<FileHash*> fd_hashes[fd_table_size];
+
+static bool in_table(int fd) {
+    return fd >= 0 && fd < fd_table_size;
+}
+
+static FileHash* file_hash(int fd) {
+    if (!in_table(fd)) return nullptr;
+    return fd_hashes[fd].load(std::memory_order_acquire);
+}
+
+static void abandon(FileHash* hash) {
+    if (!hash->state) return;
+    XXH3_freeState(hash->state);
+    hash->state = nullptr;
+}
+
+// Drops one reference; the last one frees the state.
+static bool release(FileHash* hash, FileDigest* digest) {
+    if (hash->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return false;
+    bool written = hash->written;
+    if (digest) {
+        digest->bytes = hash->bytes;
+        digest->hashed = hash->state != nullptr;
+        if (hash->state) {
+            XXH128_hash_t sum = XXH3_128bits_digest(hash->state);
+            digest->high = sum.high64;
+            digest->low = sum.low64;
+        }
+    }
+    abandon(hash);
+    delete hash;
+    return written;
+}
+
+static void replace(int fd, FileHash* hash) {
+    FileHash* old = fd_hashes[fd].exchange(hash, std::memory_order_acq_rel);
+    // The fd was closed behind the hooks' back; its file goes unreported.
+    if (old) release(old, nullptr);
+}
+
+void start_file_hash(int fd) {
+    if (!in_table(fd)) return;
+    int flags = ::fcntl(fd, F_GETFL);
+    struct stat st;
+    if (flags < 0 || (flags & O_ACCMODE) == O_RDONLY || ::fstat(fd, &st) != 0
+        || !S_ISREG(st.st_mode)) {
+        replace(fd, nullptr);
+        return;
+    }
+    FileHash* hash = new FileHash;
+    hash->append = flags & O_APPEND;
+    // Bytes already in the file never pass through the hooks.
+    if (st.st_size == 0) {
+        hash->state = XXH3_createState();
+        if (hash->state) XXH3_128bits_reset(hash->state);
+    }
+    replace(fd, hash);
+}
+
+// Feeds one write at `offset` (-1 for the file position) into the digest.
+template <class Update>
+static void add_written(int fd, size_t size, off_t offset, Update update) {
+    FileHash* hash = file_hash(fd);
+    if (!hash || !size) return;
+    std::lock_guard<std::mutex> lock(hash->mutex);
+    hash->written = true;
+    uint64_t at = hash->append ? hash->bytes
+                  : offset < 0 ? hash->position
+                               : static_cast<uint64_t>(offset);
+    if (at != hash->bytes)
+        abandon(hash);
+    else if (hash->state)
+        update(hash->state);
+    hash->bytes += size;
+    if (offset < 0) hash->position = at + size;
+}
+
+static void update_iov(XXH3_state_t* state, const struct iovec* iov,
+                       int iovcnt, size_t size) {
+    for (int i = 0; i < iovcnt && size; i++) {
+        size_t part = iov[i].iov_len < size ? iov[i].iov_len : size;
+        XXH3_128bits_update(state, iov[i].iov_base, part);
+        size -= part;
+    }
+}
+
+void hash_written(int fd, const void* data, size_t size) {
+    add_written(fd, size, -1, [&](XXH3_state_t* state) {
+        XXH3_128bits_update(state, data, size);
+    });
+}
+
+void hash_written_at(int fd, const void* data, size_t size, off_t offset) {
+    add_written(fd, size, offset, [&](XXH3_state_t* state) {
+        XXH3_128bits_update(state, data, size);
+    });
+}
+
+void hash_written_iov(int fd, const struct iovec* iov, int iovcnt,
+                      size_t size) {
+    add_written(fd, size, -1, [&](XXH3_state_t* state) {
+        update_iov(state, iov, iovcnt, size);
+    });
+}
+
+void hash_written_iov_at(int fd, const struct iovec* iov, int iovcnt,
+                         size_t size, off_t offset) {
+    add_written(fd, size, offset, [&](XXH3_state_t* state) {
+        update_iov(state, iov, iovcnt, size);
+    });
+}
+
+void break_file_hash(int fd) {
+    FileHash* hash = file_hash(fd);
+    if (!hash) return;
+    std::lock_guard<std::mutex> lock(hash->mutex);
+    hash->written = true;
+    abandon(hash);
+}
+
+void seek_file_hash(int fd, uint64_t offset) {
+    FileHash* hash = file_hash(fd);
+    if (!hash) return;
+    std::lock_guard<std::mutex> lock(hash->mutex);
+    hash->position = offset;
+}
+
+void resize_file_hash(int fd, uint64_t size) {
+    FileHash* hash = file_hash(fd);
+    if (!hash) return;
+    std::lock_guard<std::mutex> lock(hash->mutex);
+    hash->written = true;
+    if (size != hash->bytes) abandon(hash);
+}
+
+void copy_file_hash(int oldfd, int newfd) {
+    if (!in_table(newfd)) return;
+    FileHash* hash = file_hash(oldfd);
+    if (hash) hash->refs.fetch_add(1, std::memory_order_relaxed);
+    replace(newfd, hash);
+}
+
+bool finish_file_hash(int fd, FileDigest& digest) {
+    if (!in_table(fd)) return false;
+    FileHash* hash = fd_hashes[fd].exchange(nullptr, std::memory_order_acq_rel);
+    return hash && release(hash, &digest);
+}
+
+int next_hashed_fd(int fd) {
+    for (fd = fd < 0 ? 0 : fd; fd < fd_table_size; fd++)
+        if (fd_hashes[fd].load(std::memory_order_relaxed)) return fd;
+    return -1;
+}
+
+void reset_file_hashes_after_fork() {
+    // Another thread may have held a state's mutex at the fork, so the
+    // states are left alone rather than freed.
+    for (std::atomic<FileHash*>& hash : fd_hashes)
+        hash.store(nullptr, std::memory_order_relaxed);
+}
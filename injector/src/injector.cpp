@@ -1,7 +1,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <netdb.h>
+#include <limits.h>
 #include <poll.h>
 #include <pthread.h>
 #include <spawn.h>
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/sendfile.h>
 #include <sys/socket.h>
@@ -22,8 +23,9 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
-#include <chrono>
+#include <charconv>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -31,8 +33,22 @@
 #include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "event_buffer.hpp"
+#include "event_clock.hpp"
+#include "fd_table.hpp"
+#include "file_hash.hpp"
+#include "json_escape.hpp"
+#include "latency_histogram.hpp"
+#include "op_policy.hpp"
+#include "path_filter.hpp"
+#include "record.hpp"
+#include "shared_spool.hpp"
+#include "shm_ring.hpp"
+#include "spool_chunk.hpp"
+
 struct linux_dirent;
 struct linux_dirent64;
 
@@ -48,18 +64,44 @@ static std::string get_env(const char* name) {
 static const std::string slurm_job_id = "1";
 static const std::string slurm_cluster_name = "cname1";
 
-static std::string path_exec = get_env("PROV_PATH_EXEC");
-// static std::ostringstream aggregated_events_json;
-static std::vector<std::string> aggregated_events;
-static std::mutex events_mutex;
-
-static std::string now_ns() {
-    using namespace std::chrono;
-    uint64_t ts
-        = duration_cast<nanoseconds>(system_clock::now().time_since_epoch())
-              .count();
-    std::string ts_string = std::to_string(ts);
-    return ts_string;
+enum class EventFormat { Json, Binary };
+static EventFormat event_format = EventFormat::Json;
+static bool coalesce_events = false;
+// Commit events to per-thread mapped spool files (PROV_SPOOL=mmap) rather
+// than appending chunks to one spool file per process.
+static bool mapped_spool = true;
+// Write spool files as LZ4 chunks (PROV_COMPRESS=lz4). Events are then
+// written out a flush threshold at a time, also to a mapped spool.
+static bool compress_spool = false;
+static pid_t process_pid = 0;
+// Count hooked calls and time their logging per thread, for the overhead
+// summary written at exit (PROV_STATS=1).
+static bool hook_stats = false;
+// Time the real I/O calls into per-path latency histograms, written out once
+// per process (PROV_LATENCY=1).
+static bool latency_profiling = false;
+// Paths the latency tables of a thread and of the process hold; a full table
+// is written out early.
+static constexpr size_t thread_latency_paths = 64;
+static constexpr size_t process_latency_paths = 1024;
+// Fold per-call I/O events into per-path summaries, written out once per
+// process (PROV_SUMMARY=1).
+static bool summary_events = false;
+// Entries the summary tables of a thread and of the process hold; a full
+// table is written out early.
+static constexpr size_t thread_summary_paths = 256;
+static constexpr size_t process_summary_paths = 4096;
+
+static ClockSource clock_source = ClockSource::Realtime;
+
+// Event timestamp in the units of the configured clock source.
+static inline uint64_t now_ts() {
+    return read_clock(clock_source);
+}
+
+static pid_t current_pid() {
+    if (!process_pid) process_pid = getpid();
+    return process_pid;
 }
 
 static char** build_argv_from_varargs(const char* first, va_list ap) {
@@ -75,219 +117,1411 @@ static char** build_argv_from_varargs(const char* first, va_list ap) {
     return argv;
 }
 
-static inline void add_event(const std::string& operation,
-                             const std::string& ts,
-                             const std::string& event_json) {
-    std::lock_guard<std::mutex> guard(events_mutex);
-    std::string event = R"({"event_header":{"operation":")" + operation
-                        + R"(","ts":)" + ts + R"(},"event_data":)" + event_json
-                        + "}\n";
-    aggregated_events.push_back(event);
+static inline bool binary_events() {
+    return event_format == EventFormat::Binary;
 }
 
-static std::string fd_path(const int& fd) {
-    char link[64];
-    std::snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
-
-    std::array<char, 256> buf{};
-    ssize_t r = ::readlink(link, buf.data(), buf.size() - 1);
-
-    if (r >= 0) {
-        buf[r] = '\0';
-        return std::string(buf.data());
-    } else {
-        return "fd=" + std::to_string(fd);
-    }
+// Appends the decimal form of `value` without a temporary string.
+static inline void append_uint(std::string& out, uint64_t value) {
+    char digits[20];
+    std::to_chars_result result
+        = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
 }
 
-static void log_input_event(const std::string operation,
-                            const std::string path_in) {
-    // if (!path_in.starts_with(path_exec)) return;
-
-    std::string ts = now_ns();
-    std::string json = R"({"path_in":")" + path_in + R"("})";
-    add_event(operation, ts, json);
+// Appends `value` in decimal, with its sign.
+static inline void append_int(std::string& out, int64_t value) {
+    char digits[20];
+    std::to_chars_result result
+        = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
 }
 
-static void log_output_event(const std::string operation,
-                             const std::string path_out) {
-    // if (!path_out.starts_with(path_exec)) return;
-
-    std::string ts = now_ns();
-    std::string json = R"({"path_out":")" + path_out + R"("})";
-    add_event(operation, ts, json);
+// Appends one JSON event; `write_data` appends its event_data object. Events
+// are formatted in place, so once the buffer has grown to its working size
+// recording one allocates nothing.
+template <class WriteData>
+static inline void append_event(ThreadBuffer* buffer, Call call, uint64_t ts,
+                                WriteData&& write_data) {
+    std::string& data = buffer->data;
+    data += R"({"event_header":{"operation":")";
+    data += call_name(call);
+    data += R"(","ts":)";
+    append_uint(data, ts);
+    data += R"(,"tid":)";
+    append_uint(data, static_cast<uint64_t>(buffer->tid));
+    data += R"(},"event_data":)";
+    write_data(data);
+    data += "}\n";
+    buffer->buffered_events++;
+    buffer->recorded_events++;
 }
 
-static void log_input_output_event(const std::string operation,
-                                   const std::string path_in,
-                                   const std::string path_out) {
-    // if (!(path_in.starts_with(path_exec)
-    //       || path_out.starts_with(path_exec)))
-    //     return;
-
-    std::string ts = now_ns();
-    std::string json = R"({"path_in":")" + path_in + R"(","path_out":")"
-                       + path_out + R"("})";
-    add_event(operation, ts, json);
+// Log helpers take either a plain path or an interned one (from the fd
+// table). JSON events spell the path out, escaped; binary records carry its
+// id.
+static inline std::string_view path_text(std::string_view path) {
+    return path;
 }
 
-static void log_input_event_fd(const std::string operation, int path_in_fd) {
-    std::string path_in = fd_path(path_in_fd);
-    // if (!path_in.starts_with(path_exec)) return;
+static inline std::string_view path_text(const InternedPath* path) {
+    return path->path;
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"path_in":")" + path_in + R"("})";
-    add_event(operation, ts, json);
+static inline bool in_scope(std::string_view path) {
+    return path_in_scope(path);
 }
 
-static void log_output_event_fd(const std::string operation, int path_out_fd) {
-    std::string path_out = fd_path(path_out_fd);
-    // if (!path_out.starts_with(path_exec)) return;
+static inline bool in_scope(const InternedPath* path) {
+    return path->in_scope;
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"path_out":")" + path_out + R"("})";
-    add_event(operation, ts, json);
+static inline const InternedPath* path_ref(std::string_view path) {
+    return intern_path(path);
 }
 
-static void log_input_output_event_fd(const std::string operation,
-                                      int path_in_fd, int path_out_fd) {
-    std::string path_in = fd_path(path_in_fd);
-    std::string path_out = fd_path(path_out_fd);
+static inline const InternedPath* path_ref(const InternedPath* path) {
+    return path;
+}
 
-    // if (!(path_in.starts_with(path_exec)
-    //       || path_out.starts_with(path_exec)))
-    //     return;
+template <class Field>
+static inline void define_field(ThreadBuffer*, const Field&) {
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"path_in":")" + path_in + R"(","path_out":")"
-                       + path_out + R"("})";
-    add_event(operation, ts, json);
+static inline void define_field(ThreadBuffer* buffer,
+                                const InternedPath* path) {
+    // Ids past the bitmap, which are rare, are defined with every record.
+    std::vector<uint64_t>& defined = buffer->defined_paths;
+    size_t word = path->id / 64;
+    uint64_t bit = uint64_t{1} << (path->id % 64);
+    if (word < defined.size()) {
+        if (defined[word] & bit) return;
+        defined[word] |= bit;
+    }
+    RecordWriter record(buffer->data, Call::PathDef, RecordLayout::PathDef,
+                        current_pid(), buffer->tid, 0);
+    record.u32(path->id);
+    record.str(path->path);
 }
 
-static void log_fork_event(const std::string operation, pid_t child_pid) {
-    std::string ts = now_ns();
-    std::string json = R"({"child_pid":)" + std::to_string(child_pid) + R"(})";
-    add_event(operation, ts, json);
+static inline void write_field(RecordWriter& record, std::string_view value) {
+    record.str(value);
 }
 
-static void log_spawn_event(const std::string operation, pid_t child_pid,
-                            const std::string target) {
-    // if (!target.starts_with(path_exec)) return;
+static inline void write_field(RecordWriter& record, uint64_t value) {
+    record.u64(value);
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"child_pid":)" + std::to_string(child_pid)
-                       + R"(,"path":")" + target + R"("})";
-    add_event(operation, ts, json);
+static inline void write_field(RecordWriter& record, const InternedPath* path) {
+    record.u32(path->id);
 }
 
-static void log_exec_event(const std::string operation,
-                           const std::string target) {
-    // if (!target.starts_with(path_exec)) return;
+template <class... Fields>
+static inline void append_record(ThreadBuffer* buffer, Call call,
+                                 RecordLayout layout, uint64_t ts,
+                                 const Fields&... fields) {
+    (define_field(buffer, fields), ...);
+    RecordWriter record(buffer->data, call, layout, current_pid(), buffer->tid,
+                        ts);
+    (write_field(record, fields), ...);
+    buffer->buffered_events++;
+    buffer->recorded_events++;
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"path":")" + target + R"("})";
-    add_event(operation, ts, json);
+// Emits the thread's open I/O run, if any, as one counted record.
+static void emit_run(ThreadBuffer* buffer) {
+    PendingRun& run = buffer->run;
+    if (!run.count) return;
+    if (binary_events()) {
+        append_record(buffer, run.call,
+                      run.output ? RecordLayout::PathOutRun
+                                 : RecordLayout::PathInRun,
+                      run.first_ts, run.path, run.count, run.bytes,
+                      run.last_ts);
+    } else {
+        append_event(buffer, run.call, run.first_ts, [&](std::string& json) {
+            json += run.output ? R"({"path_out":)" : R"({"path_in":)";
+            append_json_string(json, path_text(run.path));
+            json += R"(,"count":)";
+            append_uint(json, run.count);
+            json += R"(,"bytes":)";
+            append_uint(json, run.bytes);
+            json += R"(,"ts_end":)";
+            append_uint(json, run.last_ts);
+            json += '}';
+        });
+    }
+    run.count = 0;
+}
+
+static std::mutex spool_mutex;
+
+// Opens this process's spool file for appending and writes the file header
+// if it is new. Callers hold spool_mutex. The file is reopened for every
+// chunk, so forked children and programs that close inherited fds never
+// write through a stale descriptor. A compressed file (.lz4) holds the
+// events as chunks after the plain file header.
+static int open_spool() {
+    const char* path_write = std::getenv("PROV_PATH_WRITE");
+    char path[PATH_MAX];
+    int length = std::snprintf(path, sizeof(path), "%s/%d%s%s",
+                               path_write ? path_write : "", current_pid(),
+                               binary_events() ? ".bin" : ".jsonl",
+                               compress_spool ? ".lz4" : "");
+    if (length < 0 || static_cast<size_t>(length) >= sizeof(path)) return -1;
+    int fd = syscall(SYS_open, path,
+                     O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return fd;
+    struct stat st;
+    if (binary_events() && syscall(SYS_fstat, fd, &st) == 0
+        && st.st_size == 0) {
+        RecordFileHeader header = record_file_header();
+        syscall(SYS_write, fd, &header, sizeof(header));
+    }
+    return fd;
 }
 
-static void log_exec_fd_event(const std::string operation, int path_target_fd) {
-    std::string target_string = fd_path(path_target_fd);
-    // if (!target_string.starts_with(path_exec)) return;
+// Maps the thread's spool file on first use. Names are taken with O_EXCL,
+// since after an exec the new image reuses the pid and the main thread's tid.
+static bool spool_mapped(ThreadBuffer* buffer) {
+    if (buffer->spool) return true;
+    if (!mapped_spool || !buffer->spool_path.empty()) return false;
+    std::string path_write = get_env("PROV_PATH_WRITE");
+    if (path_write.empty()) return false;
+    std::string prefix = path_write + "/" + std::to_string(current_pid()) + "."
+                         + std::to_string(buffer->tid) + ".";
+    for (int generation = 0; generation < 64; generation++) {
+        if (map_thread_spool(buffer,
+                             prefix + std::to_string(generation) + ".spool",
+                             current_pid(), binary_events(), compress_spool))
+            return true;
+        if (errno != EEXIST) return false;
+    }
+    return false;
+}
+
+static RingHeader* event_ring = nullptr;
+
+// Maps the ring prov created for live consumption, if any (PROV_RING).
+static void map_event_ring() {
+    std::string path = get_env("PROV_RING");
+    if (path.empty()) return;
+    int fd = syscall(SYS_open, path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (syscall(SYS_fstat, fd, &st) == 0
+        && static_cast<size_t>(st.st_size) > sizeof(RingHeader))
+        map = reinterpret_cast<void*>(syscall(SYS_mmap, nullptr, st.st_size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_SHARED, fd, 0));
+    syscall(SYS_close, fd);
+    if (map == MAP_FAILED) return;
+    RingHeader* ring = static_cast<RingHeader*>(map);
+    if (std::memcmp(ring->magic, ring_magic, sizeof(ring_magic)) != 0
+        || ring->version != record_version
+        || ring_mapping_size(ring->capacity)
+               > static_cast<size_t>(st.st_size)) {
+        syscall(SYS_munmap, map, st.st_size);
+        return;
+    }
+    event_ring = ring;
+}
+
+static SharedSpoolHeader* shared_spool = nullptr;
+
+// Maps the spool all processes of the run append to (PROV_SPOOL=shared), if
+// prov created one. A forked child inherits the mapping.
+static void map_shared_spool() {
+    std::string path = get_env("PROV_SHARED_SPOOL");
+    if (path.empty()) return;
+    int fd = syscall(SYS_open, path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (syscall(SYS_fstat, fd, &st) == 0
+        && static_cast<size_t>(st.st_size) > sizeof(SharedSpoolHeader))
+        map = reinterpret_cast<void*>(syscall(SYS_mmap, nullptr, st.st_size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_SHARED, fd, 0));
+    syscall(SYS_close, fd);
+    if (map == MAP_FAILED) return;
+    SharedSpoolHeader* spool = static_cast<SharedSpoolHeader*>(map);
+    if (std::memcmp(spool->magic, shared_spool_magic,
+                    sizeof(shared_spool_magic))
+            != 0
+        || spool->version != record_version
+        || shared_spool_size(spool->capacity)
+               > static_cast<size_t>(st.st_size)) {
+        syscall(SYS_munmap, map, st.st_size);
+        return;
+    }
+    shared_spool = spool;
+}
+
+// Packs the buffered events into one compressed chunk in buffer->packed.
+static bool pack_events(ThreadBuffer* buffer) {
+    if (buffer->codec_state.empty())
+        buffer->codec_state.resize((LZ4_sizeofState() + 7) / 8);
+    buffer->packed.clear();
+    return append_chunk(buffer->packed, buffer->data.data(),
+                        buffer->data.size(), buffer->codec_state.data());
+}
+
+// Bytes of the shared spool a thread takes at a time for its events.
+static constexpr size_t shared_chunk_bytes = size_t{64} << 10;
+
+// Commits the buffered events to the thread's open chunk of the shared spool,
+// opening a new one when they do not fit, and empties the buffer. Path
+// definitions are kept: prov reads a process's chunks in order.
+static bool commit_shared_events(ThreadBuffer* buffer) {
+    const std::string& data = buffer->data;
+    if (!buffer->shared_chunk
+        || !shared_chunk_append(buffer->shared_chunk, data.data(),
+                                data.size())) {
+        SharedChunk* chunk
+            = shared_chunk_open(shared_spool, current_pid(),
+                                std::max(shared_chunk_bytes, data.size()));
+        if (!chunk) return false;
+        buffer->shared_chunk = chunk;
+        shared_chunk_append(chunk, data.data(), data.size());
+    }
+    buffer->data.clear();
+    buffer->buffered_events = 0;
+    return true;
+}
+
+// Hands the buffered events to prov's ring when one is mapped, and commits
+// them to the shared spool or the thread's mapped spool, or appends them to
+// the process's spool file when there is none or it is full. Only spool
+// files are compressed; the ring is drained while the command runs.
+static bool write_events(ThreadBuffer* buffer) {
+    if (buffer->data.empty()) return true;
+    if (event_ring
+        && ring_write(event_ring, current_pid(), buffer->data.data(),
+                      buffer->data.size())) {
+        clear_thread_buffer(buffer);
+        return true;
+    }
+    if (compress_spool && !pack_events(buffer)) return false;
+    if (shared_spool) {
+        if (!compress_spool && commit_shared_events(buffer)) {
+            // Later chunks may go to the ring, which needs its own
+            // definitions.
+            if (event_ring) forget_defined_paths(buffer);
+            return true;
+        }
+        if (compress_spool
+            && shared_spool_write(shared_spool, current_pid(),
+                                  buffer->packed.data(),
+                                  buffer->packed.size())) {
+            clear_thread_buffer(buffer);
+            return true;
+        }
+        // Full for good: later chunks go to the process's spool file, which
+        // prov reads with its own path table.
+        forget_defined_paths(buffer);
+    }
+    if (spool_mapped(buffer)
+        && (compress_spool ? commit_thread_chunk(buffer, buffer->packed)
+                           : commit_thread_buffer(buffer))) {
+        // Later chunks may go to the ring, which needs its own definitions.
+        if (event_ring) forget_defined_paths(buffer);
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(spool_mutex);
+    int fd = open_spool();
+    if (fd < 0) return false;
+    bool written = compress_spool
+                       ? write_thread_chunk(fd, buffer, buffer->packed)
+                       : write_thread_buffer(fd, buffer);
+    syscall(SYS_close, fd);
+    return written;
+}
+
+// Writes the buffer out once it reaches the flush threshold. After a failed
+// write the next attempt waits for another threshold's worth of events.
+static void stream_events(ThreadBuffer* buffer) {
+    // A mapped or shared spool takes every event as it is recorded, so the
+    // kernel holds it even if the process never reaches the exit flush.
+    // Compressed chunks and the ring wait for the threshold, an exec or the
+    // exit.
+    if (!event_ring && !compress_spool
+        && (shared_spool ? commit_shared_events(buffer)
+                         : spool_mapped(buffer)
+                               && commit_thread_buffer(buffer)))
+        return;
+    size_t threshold = buffer_limits.flush_bytes;
+    if (!threshold || buffer->data.size() < threshold
+        || buffer->data.size() < buffer->next_flush)
+        return;
+    bool written = write_events(buffer);
+    buffer->next_flush = written ? 0 : buffer->data.size() + threshold;
+}
+
+template <class WriteData>
+static inline void add_event(Call call, uint64_t ts, WriteData&& write_data) {
+    ThreadBuffer* buffer = acquire_thread_buffer();
+    if (!buffer) return;
+    emit_run(buffer);
+    if (reserve_thread_buffer(buffer)) {
+        append_event(buffer, call, ts, write_data);
+        stream_events(buffer);
+    }
+    release_thread_buffer(buffer);
+}
+
+template <class... Fields>
+static inline void add_record(Call call, RecordLayout layout, uint64_t ts,
+                              const Fields&... fields) {
+    ThreadBuffer* buffer = acquire_thread_buffer();
+    if (!buffer) return;
+    emit_run(buffer);
+    if (reserve_thread_buffer(buffer)) {
+        append_record(buffer, call, layout, ts, fields...);
+        stream_events(buffer);
+    }
+    release_thread_buffer(buffer);
+}
+
+static inline bool coalesces(Call call) {
+    switch (call_op(call)) {
+        case SysOp::Write:
+        case SysOp::Writev:
+        case SysOp::Pwrite:
+        case SysOp::Pwritev:
+        case SysOp::Read:
+        case SysOp::Readv:
+        case SysOp::Pread:
+        case SysOp::Preadv:
+        case SysOp::Getdents:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Folds the call into the thread's open run when it continues it (same fd,
+// path and operation class); otherwise emits the run and starts a new one.
+// The run keeps `path`, so it must be interned.
+static void extend_run(Call call, int fd, const InternedPath* path,
+                       bool output, uint64_t bytes) {
+    uint64_t ts = now_ts();
+    ThreadBuffer* buffer = acquire_thread_buffer();
+    if (!buffer) return;
+    PendingRun& run = buffer->run;
+    if (run.count && run.fd == fd && run.path == path
+        && call_op(run.call) == call_op(call)) {
+        run.last_ts = ts;
+        run.count++;
+        run.bytes += bytes;
+    } else {
+        emit_run(buffer);
+        stream_events(buffer);
+        run = PendingRun{.call = call,
+                         .fd = fd,
+                         .path = path,
+                         .output = output,
+                         .first_ts = ts,
+                         .last_ts = ts,
+                         .count = 1,
+                         .bytes = bytes};
+    }
+    release_thread_buffer(buffer);
+}
 
-    std::string ts = now_ns();
-    std::string json = R"({"path":")" + target_string + R"("})";
-    add_event(operation, ts, json);
+static inline uint64_t transferred(ssize_t ret) {
+    return ret > 0 ? static_cast<uint64_t>(ret) : 0;
 }
 
-static void log_exec_fail_event(const std::string operation,
-                                const std::string target, int err) {
-    // if (!target.starts_with(path_exec)) return;
+// Resolves through the fd table and only falls back to readlink for
+// descriptors whose open was not seen.
+static const InternedPath* fd_path(int fd) {
+    if (const InternedPath* cached = lookup_fd(fd)) return cached;
 
-    std::string ts = now_ns();
-    std::string json = R"({"path":")" + target + R"(","error":)"
-                       + std::to_string(err) + R"(})";
-    add_event(operation, ts, json);
-}
+    char link[64];
+    std::snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
 
-static void log_net_send_event(const std::string& operation, int sockfd,
+    std::array<char, 256> buf{};
+    ssize_t r = ::readlink(link, buf.data(), buf.size() - 1);
+
+    if (r >= 0) {
+        return intern_path(std::string_view(buf.data(), r));
+    } else {
+        char name[16];
+        int length = std::snprintf(name, sizeof(name), "fd=%d", fd);
+        return intern_path(std::string_view(name, length));
+    }
+}
+
+// Set while the calling thread is inside the injector's own logging. A hook
+// reached from there (an allocator or a signal handler doing I/O) goes
+// straight to the real function, so logging never recurses and a thread
+// buffer is never entered twice.
+static thread_local bool in_logging
+    __attribute__((tls_model("initial-exec"))) = false;
+
+// Marks the thread as logging for its lifetime. A nested scope records
+// nothing.
+class LoggingScope {
+   public:
+    LoggingScope() : nested(in_logging) {
+        in_logging = true;
+    }
+    ~LoggingScope() {
+        if (!nested) in_logging = false;
+    }
+    LoggingScope(const LoggingScope&) = delete;
+    LoggingScope& operator=(const LoggingScope&) = delete;
+
+    const bool nested;
+};
+
+// Appends one record per path and kind of I/O in `latencies` with the
+// histogram of its real call latencies.
+static void append_latencies(ThreadBuffer* buffer,
+                             const PathLatencies& latencies, uint64_t ts) {
+    latencies.for_each([&](const InternedPath* path,
+                           const PathLatency& latency) {
+        for (int kind = 0; kind < io_kind_count; kind++) {
+            const LatencyHistogram& histogram = latency.kinds[kind];
+            if (!histogram.calls) continue;
+            uint64_t buckets = 0;
+            for (uint64_t count : histogram.counts) buckets += count != 0;
+            if (binary_events()) {
+                define_field(buffer, path);
+                RecordWriter record(buffer->data, Call::Latency,
+                                    RecordLayout::Latency, current_pid(),
+                                    buffer->tid, ts);
+                record.u32(path->id);
+                record.u64(kind);
+                record.u64(histogram.calls);
+                record.u64(histogram.total_ns);
+                record.u64(buckets);
+                for (int i = 0; i < latency_buckets; i++) {
+                    if (!histogram.counts[i]) continue;
+                    record.u64(i);
+                    record.u64(histogram.counts[i]);
+                }
+                continue;
+            }
+            append_event(buffer, Call::Latency, ts, [&](std::string& json) {
+                json += R"({"path":)";
+                append_json_string(json, path_text(path));
+                json += R"(,"io":")";
+                json += io_kind_names[kind];
+                json += R"(","calls":)";
+                append_uint(json, histogram.calls);
+                json += R"(,"total_ns":)";
+                append_uint(json, histogram.total_ns);
+                json += R"(,"histogram":[)";
+                const char* separator = "";
+                for (int i = 0; i < latency_buckets; i++) {
+                    if (!histogram.counts[i]) continue;
+                    json += separator;
+                    json += '[';
+                    append_uint(json, i);
+                    json += ',';
+                    append_uint(json, histogram.counts[i]);
+                    json += ']';
+                    separator = ",";
+                }
+                json += "]}";
+            });
+        }
+    });
+}
+
+// Adds the latency of a real call on `fd` that began at `start` (monotonic)
+// to the calling thread's histogram for the fd's path. Skipped descriptors,
+// paths out of scope and paths recorded without interning are not profiled.
+// A full table is written out as records, which the receiver adds up per
+// path.
+static void note_latency(int fd, IoKind kind, uint64_t start) {
+    uint64_t elapsed = read_clock_id(CLOCK_MONOTONIC) - start;
+    LoggingScope scope;
+    if (scope.nested) return;
+    if (fd_skipped(fd)) return;
+    const InternedPath* path = fd_path(fd);
+    if (!in_scope(path) || !path->interned) return;
+    ThreadBuffer* buffer = acquire_thread_buffer();
+    if (!buffer) return;
+    PathLatency* latency = buffer->latencies.find_or_add(path);
+    if (!latency) {
+        append_latencies(buffer, buffer->latencies, now_ts());
+        buffer->latencies.clear();
+        latency = buffer->latencies.find_or_add(path);
+    }
+    if (latency) latency->kinds[static_cast<uint8_t>(kind)].add(elapsed);
+    release_thread_buffer(buffer);
+}
+
+static inline uint64_t latency_start() {
+    return latency_profiling ? read_clock_id(CLOCK_MONOTONIC) : 0;
+}
+
+// Charges a hooked call and the time spent logging it to the calling thread.
+// The filters are timed too, so calls that record nothing still show what
+// they cost. Holds a LoggingScope; a nested timer charges nothing.
+class HookTimer {
+   public:
+    explicit HookTimer(Call call)
+        : call(call), start(hook_stats ? read_clock_id(CLOCK_MONOTONIC) : 0) {
+    }
+    ~HookTimer() {
+        if (!hook_stats || scope.nested) return;
+        uint64_t elapsed = read_clock_id(CLOCK_MONOTONIC) - start;
+        ThreadBuffer* buffer = acquire_thread_buffer();
+        if (!buffer) return;
+        HookCost& cost = buffer->hook_costs[static_cast<uint16_t>(call)];
+        cost.calls++;
+        cost.log_ns += elapsed;
+        release_thread_buffer(buffer);
+    }
+    HookTimer(const HookTimer&) = delete;
+    HookTimer& operator=(const HookTimer&) = delete;
+
+    bool nested() const {
+        return scope.nested;
+    }
+
+   private:
+    LoggingScope scope;
+    Call call;
+    uint64_t start;
+};
+
+// The record_* helpers format and buffer one event; the log_* helpers the
+// hooks call first apply the op policy and the path scope.
+template <class Path>
+static void record_input_event(Call call, const Path& path_in) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::PathIn, ts, path_ref(path_in));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path_in":)";
+        append_json_string(json, path_text(path_in));
+        json += '}';
+    });
+}
+
+template <class Path>
+static void record_output_event(Call call, const Path& path_out) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::PathOut, ts, path_ref(path_out));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path_out":)";
+        append_json_string(json, path_text(path_out));
+        json += '}';
+    });
+}
+
+template <class PathIn, class PathOut>
+static void record_input_output_event(Call call, const PathIn& path_in,
+                                      const PathOut& path_out) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::PathInOut, ts, path_ref(path_in),
+                   path_ref(path_out));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path_in":)";
+        append_json_string(json, path_text(path_in));
+        json += R"(,"path_out":)";
+        append_json_string(json, path_text(path_out));
+        json += '}';
+    });
+}
+
+// Reads, writes and transfers also carry the bytes they moved.
+static void record_io_event(Call call, const InternedPath* path, bool output,
+                            uint64_t bytes) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call,
+                   output ? RecordLayout::PathOutBytes
+                          : RecordLayout::PathInBytes,
+                   ts, path, bytes);
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += output ? R"({"path_out":)" : R"({"path_in":)";
+        append_json_string(json, path_text(path));
+        json += R"(,"bytes":)";
+        append_uint(json, bytes);
+        json += '}';
+    });
+}
+
+static void record_transfer_event(Call call, const InternedPath* path_in,
+                                  const InternedPath* path_out,
+                                  uint64_t bytes) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::PathInOutBytes, ts, path_in, path_out,
+                   bytes);
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path_in":)";
+        append_json_string(json, path_text(path_in));
+        json += R"(,"path_out":)";
+        append_json_string(json, path_text(path_out));
+        json += R"(,"bytes":)";
+        append_uint(json, bytes);
+        json += '}';
+    });
+}
+
+// Classes summary mode folds into per-path summaries: the ones issued once
+// per block or descriptor. Metadata changes, execs, process and network
+// events stay events, since the receiver needs them in order.
+static inline bool summarized(Call call) {
+    if (!summary_events) return false;
+    switch (call_op(call)) {
+        case SysOp::Open:
+        case SysOp::Close:
+        case SysOp::Dup:
+        case SysOp::Pipe:
+        case SysOp::Read:
+        case SysOp::Readv:
+        case SysOp::Pread:
+        case SysOp::Preadv:
+        case SysOp::Getdents:
+        case SysOp::Write:
+        case SysOp::Writev:
+        case SysOp::Pwrite:
+        case SysOp::Pwritev:
+        case SysOp::Truncate:
+        case SysOp::Msync:
+        case SysOp::Fallocate:
+        case SysOp::Transfer:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// One path's summary, for a path the tables cannot keep.
+struct SingleSummary {
+    SummaryKey key;
+    PathSummary summary;
+
+    template <class Visit>
+    void for_each(Visit&& visit) const {
+        visit(key, summary);
+    }
+    bool empty() const {
+        return false;
+    }
+    size_t size() const {
+        return 1;
+    }
+};
+
+// Appends one SUMMARY record holding every entry of `summaries`.
+template <class Summaries>
+static void append_summary(ThreadBuffer* buffer, const Summaries& summaries,
+                           uint64_t ts) {
+    if (summaries.empty()) return;
+    if (binary_events()) {
+        summaries.for_each([&](const SummaryKey& key, const PathSummary&) {
+            define_field(buffer, key.path);
+        });
+        RecordWriter record(buffer->data, Call::Summary, RecordLayout::Summary,
+                            current_pid(), buffer->tid, ts);
+        record.u64(summaries.size());
+        summaries.for_each(
+            [&](const SummaryKey& key, const PathSummary& summary) {
+                record.u32(key.path->id);
+                record.u64(static_cast<uint64_t>(key.op));
+                record.u64(key.output);
+                record.u64(summary.count);
+                record.u64(summary.bytes);
+                record.u64(summary.first_ts);
+                record.u64(summary.last_ts);
+            });
+        return;
+    }
+    append_event(buffer, Call::Summary, ts, [&](std::string& json) {
+        json += R"({"paths":[)";
+        const char* separator = "";
+        summaries.for_each(
+            [&](const SummaryKey& key, const PathSummary& summary) {
+                json += separator;
+                json += R"({"op":")";
+                json += sysop_names[static_cast<uint8_t>(key.op)];
+                json += key.output ? R"(","path_out":)" : R"(","path_in":)";
+                append_json_string(json, path_text(key.path));
+                json += R"(,"count":)";
+                append_uint(json, summary.count);
+                json += R"(,"bytes":)";
+                append_uint(json, summary.bytes);
+                json += R"(,"first_ts":)";
+                append_uint(json, summary.first_ts);
+                json += R"(,"last_ts":)";
+                append_uint(json, summary.last_ts);
+                json += '}';
+                separator = ",";
+            });
+        json += "]}";
+    });
+}
+
+// Counts the call against its path in the calling thread's summary.
+static void summarize(Call call, const InternedPath* path, bool output,
+                      uint64_t bytes) {
+    uint64_t ts = now_ts();
+    ThreadBuffer* buffer = acquire_thread_buffer();
+    if (!buffer) return;
+    SummaryKey key{path, call_op(call), output};
+    if (!path->interned) {
+        // Recorded without interning: the count goes out at once.
+        SingleSummary single{.key = key, .summary = {}};
+        single.summary.add(ts, bytes);
+        emit_run(buffer);
+        append_summary(buffer, single, ts);
+        stream_events(buffer);
+        release_thread_buffer(buffer);
+        return;
+    }
+    PathSummary* summary = buffer->summaries.find_or_add(key);
+    if (!summary) {
+        // Full: the entries so far go out as a SUMMARY of their own, which
+        // the receiver adds to the others of the pid.
+        emit_run(buffer);
+        append_summary(buffer, buffer->summaries, ts);
+        buffer->summaries.clear();
+        stream_events(buffer);
+        summary = buffer->summaries.find_or_add(key);
+    }
+    if (summary) summary->add(ts, bytes);
+    release_thread_buffer(buffer);
+}
+
+// Process totals of the thread summaries, allocated at startup.
+static PathSummaries process_summaries;
+
+// Writes out the process's SUMMARY record while recording is stopped, at exit
+// or before an exec, and starts the totals afresh. The receiver adds up the
+// summaries of one pid.
+static void log_summary() {
+    ThreadBuffer* buffer = local_thread_buffer;
+    if (!buffer) buffer = register_thread_buffer();
+    emit_run(buffer);
+    append_summary(buffer, process_summaries, now_ts());
+    process_summaries.clear();
+    write_events(buffer);
+}
+
+static void add_thread_summaries(const ThreadBuffer* buffer) {
+    buffer->summaries.for_each(
+        [](const SummaryKey& key, const PathSummary& summary) {
+            PathSummary* total = process_summaries.find_or_add(key);
+            if (!total) {
+                log_summary();
+                total = process_summaries.find_or_add(key);
+            }
+            total->merge(summary);
+        });
+}
+
+template <class Path>
+static void log_input_event(Call call, const Path& path_in) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call))) return;
+    // system() commands are exempt like exec targets.
+    if (call != Call::System && !in_scope(path_in)) return;
+    if (summarized(call)) {
+        summarize(call, path_ref(path_in), false, 0);
+        return;
+    }
+    record_input_event(call, path_in);
+}
+
+template <class Path>
+static void log_output_event(Call call, const Path& path_out) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call)) || !in_scope(path_out)) return;
+    if (summarized(call)) {
+        summarize(call, path_ref(path_out), true, 0);
+        return;
+    }
+    record_output_event(call, path_out);
+}
+
+template <class PathIn, class PathOut>
+static void log_input_output_event(Call call, const PathIn& path_in,
+                                   const PathOut& path_out) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call))) return;
+    if (!in_scope(path_in) && !in_scope(path_out)) return;
+    if (summarized(call)) {
+        summarize(call, path_ref(path_in), false, 0);
+        summarize(call, path_ref(path_out), true, 0);
+        return;
+    }
+    record_input_output_event(call, path_in, path_out);
+}
+
+static void log_input_event_fd(Call call, int path_in_fd,
+                               uint64_t bytes = 0) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (fd_skipped(path_in_fd) || !op_recorded(call_op(call))) return;
+    const InternedPath* path_in = fd_path(path_in_fd);
+    if (!in_scope(path_in)) return;
+
+    if (summarized(call)) {
+        summarize(call, path_in, false, bytes);
+        return;
+    }
+    if (coalesces(call)) {
+        if (coalesce_events && path_in->interned)
+            extend_run(call, path_in_fd, path_in, false, bytes);
+        else
+            record_io_event(call, path_in, false, bytes);
+        return;
+    }
+    record_input_event(call, path_in);
+}
+
+static void log_output_event_fd(Call call, int path_out_fd,
+                                uint64_t bytes = 0) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (fd_skipped(path_out_fd) || !op_recorded(call_op(call))) return;
+    const InternedPath* path_out = fd_path(path_out_fd);
+    if (!in_scope(path_out)) return;
+
+    if (summarized(call)) {
+        summarize(call, path_out, true, bytes);
+        return;
+    }
+    if (coalesces(call)) {
+        if (coalesce_events && path_out->interned)
+            extend_run(call, path_out_fd, path_out, true, bytes);
+        else
+            record_io_event(call, path_out, true, bytes);
+        return;
+    }
+    record_output_event(call, path_out);
+}
+
+static void log_input_output_event_fd(Call call, int path_in_fd,
+                                      int path_out_fd) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (fd_skipped(path_in_fd) && fd_skipped(path_out_fd)) return;
+    if (!op_recorded(call_op(call))) return;
+    const InternedPath* path_in = fd_path(path_in_fd);
+    const InternedPath* path_out = fd_path(path_out_fd);
+    if (!in_scope(path_in) && !in_scope(path_out)) return;
+    if (summarized(call)) {
+        summarize(call, path_in, false, 0);
+        summarize(call, path_out, true, 0);
+        return;
+    }
+    record_input_output_event(call, path_in, path_out);
+}
+
+static void log_transfer_event_fd(Call call, int path_in_fd, int path_out_fd,
+                                  uint64_t bytes) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (fd_skipped(path_in_fd) && fd_skipped(path_out_fd)) return;
+    if (!op_recorded(call_op(call))) return;
+    const InternedPath* path_in = fd_path(path_in_fd);
+    const InternedPath* path_out = fd_path(path_out_fd);
+    if (!in_scope(path_in) && !in_scope(path_out)) return;
+    if (summarized(call)) {
+        summarize(call, path_in, false, bytes);
+        summarize(call, path_out, true, bytes);
+        return;
+    }
+    record_transfer_event(call, path_in, path_out, bytes);
+}
+
+static void log_fork_event(Call call, pid_t child_pid) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call))) return;
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::ChildPid, ts,
+                   static_cast<uint64_t>(child_pid));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"child_pid":)";
+        append_int(json, child_pid);
+        json += '}';
+    });
+}
+
+static void log_spawn_event(Call call, pid_t child_pid,
+                            std::string_view target) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call))) return;
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::ChildPidPath, ts,
+                   static_cast<uint64_t>(child_pid), path_ref(target));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"child_pid":)";
+        append_int(json, child_pid);
+        json += R"(,"path":)";
+        append_json_string(json, path_text(target));
+        json += '}';
+    });
+}
+
+template <class Path>
+static void record_exec_event(Call call, const Path& target) {
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::Path, ts, path_ref(target));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path":)";
+        append_json_string(json, path_text(target));
+        json += '}';
+    });
+}
+
+// Writes out every thread's events before an exec replaces the image, as the
+// destructors that would flush them never run, and in summary mode what all
+// of them have summarized. Recording resumes in case the exec fails.
+static void save_events_before_exec() {
+    checkpoint_thread_buffers(
+        [](ThreadBuffer* buffer) {
+            if (summary_events) {
+                add_thread_summaries(buffer);
+                buffer->summaries.clear();
+            }
+            emit_run(buffer);
+            write_events(buffer);
+        },
+        [] {
+            if (summary_events) log_summary();
+        });
+}
+
+template <class Path>
+static void log_exec_event(Call call, const Path& target) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (op_recorded(call_op(call))) record_exec_event(call, target);
+    save_events_before_exec();
+}
+
+static void log_exec_fd_event(Call call, int path_target_fd) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (op_recorded(call_op(call)))
+        record_exec_event(call, fd_path(path_target_fd));
+    save_events_before_exec();
+}
+
+template <class Path>
+static void log_exec_fail_event(Call call, const Path& target, int err) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    // Failed execs have no class of their own and follow exec.
+    if (!op_recorded(SysOp::Exec)) return;
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(call, RecordLayout::PathError, ts, path_ref(target),
+                   static_cast<uint64_t>(err));
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"path":)";
+        append_json_string(json, path_text(target));
+        json += R"(,"error":)";
+        append_int(json, err);
+        json += '}';
+    });
+}
+
+// The peer address is copied as raw sockaddr bytes and formatted by the
+// receiver, so the hook does no lookup.
+static void log_net_event(Call call, int sockfd, const struct sockaddr* sa,
+                          socklen_t salen, unsigned count) {
+    HookTimer timer(call);
+    if (timer.nested()) return;
+    if (!op_recorded(call_op(call))) return;
+    uint64_t ts = now_ts();
+    std::string_view addr;
+    if (sa)
+        addr = std::string_view(
+            reinterpret_cast<const char*>(sa),
+            std::min<size_t>(salen, sizeof(struct sockaddr_storage)));
+    if (binary_events()) {
+        add_record(call, RecordLayout::Net, ts, static_cast<uint64_t>(sockfd),
+                   static_cast<uint64_t>(count), addr);
+        return;
+    }
+    add_event(call, ts, [&](std::string& json) {
+        json += R"({"fd":)";
+        append_int(json, sockfd);
+        json += R"(,"count":)";
+        append_uint(json, count);
+        if (!addr.empty()) {
+            json += R"(,"sockaddr":")";
+            append_hex(json, addr);
+            json += '"';
+        }
+        json += '}';
+    });
+}
+
+static void log_net_send_event(Call call, int sockfd,
                                const struct sockaddr* sa, socklen_t salen,
                                unsigned count) {
-    std::string ts = now_ns();
-    std::string addr_str;
-    if (sa && salen > 0) {
-        char buf[128] = {0};
-        getnameinfo(sa, salen, buf, sizeof(buf), nullptr, 0, NI_NUMERICHOST);
-        addr_str = buf;
-    }
-
-    std::string json
-        = R"({"fd":)" + std::to_string(sockfd) + R"(,"count":)"
-          + std::to_string(count)
-          + (addr_str.empty() ? "" : R"(,"addr":")" + addr_str + R"(")")
-          + R"(})";
-    add_event(operation, ts, json);
+    log_net_event(call, sockfd, sa, salen, count);
 }
 
-static void log_net_recv_event(const std::string& operation, int sockfd,
+static void log_net_recv_event(Call call, int sockfd,
                                const struct sockaddr* sa, socklen_t salen,
                                unsigned count) {
-    std::string ts = now_ns();
-    std::string addr_str;
-    if (sa && salen > 0) {
-        char buf[128] = {0};
-        getnameinfo(sa, salen, buf, sizeof(buf), nullptr, 0, NI_NUMERICHOST);
-        addr_str = buf;
-    }
-
-    std::string json
-        = R"({"fd":)" + std::to_string(sockfd) + R"(,"count":)"
-          + std::to_string(count)
-          + (addr_str.empty() ? "" : R"(,"addr":")" + addr_str + R"(")")
-          + R"(})";
-    add_event(operation, ts, json);
+    log_net_event(call, sockfd, sa, salen, count);
+}
+
+// Reports the content digest of a written file once its last fd closes, or
+// that the file has to be hashed after the fact. Called with the fd still
+// open.
+static void log_file_digest(int fd) {
+    LoggingScope scope;
+    if (scope.nested) return;
+    FileDigest digest;
+    if (!finish_file_hash(fd, digest)) return;
+    // Digests have no class of their own and follow write.
+    if (!op_recorded(SysOp::Write)) return;
+    const InternedPath* path = fd_path(fd);
+    if (!in_scope(path)) return;
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(Call::FileDigest, RecordLayout::FileDigest, ts, path,
+                   digest.bytes, static_cast<uint64_t>(digest.hashed),
+                   digest.high, digest.low);
+        return;
+    }
+    add_event(Call::FileDigest, ts, [&](std::string& json) {
+        json += R"({"path":)";
+        append_json_string(json, path_text(path));
+        json += R"(,"bytes":)";
+        append_uint(json, digest.bytes);
+        if (digest.hashed) {
+            char hex[33];
+            std::snprintf(hex, sizeof(hex), "%016llx%016llx",
+                          static_cast<unsigned long long>(digest.high),
+                          static_cast<unsigned long long>(digest.low));
+            json += R"(,"xxh3_128":")";
+            json += hex;
+            json += R"("})";
+        } else {
+            json += R"(,"rehash":true})";
+        }
+    });
+}
+
+static void log_open_file_digests() {
+    for (int fd = next_hashed_fd(0); fd >= 0; fd = next_hashed_fd(fd + 1))
+        log_file_digest(fd);
+}
+
+// Pairs a raw reading of the event clock with wall-clock ns, once per
+// process, so raw timestamps can be converted back.
+static void log_clock_anchor() {
+    uint64_t ts = now_ts();
+    uint64_t wall_ns = read_clock_id(CLOCK_REALTIME);
+    if (binary_events()) {
+        add_record(Call::ClockAnchor, RecordLayout::ClockAnchor, ts,
+                   static_cast<uint64_t>(clock_source), wall_ns);
+        return;
+    }
+    add_event(Call::ClockAnchor, ts, [&](std::string& json) {
+        json += R"({"clock":")";
+        json += clock_source_name(clock_source);
+        json += R"(","wall_ns":)";
+        append_uint(json, wall_ns);
+        json += '}';
+    });
 }
 
 static void log_process_start() {
-    pid_t pid = getpid();
+    pid_t pid = current_pid();
     pid_t ppid = getppid();
-    std::string ts = now_ns();
-    std::string operation = "START_PROCESS";
-    std::string json = R"({"pid":)" + std::to_string(pid) + R"(,"ppid":)"
-                       + std::to_string(ppid) + R"(})";
-    add_event(operation, ts, json);
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(Call::StartProcess, RecordLayout::ProcessStart, ts,
+                   static_cast<uint64_t>(ppid));
+        return;
+    }
+    add_event(Call::StartProcess, ts, [&](std::string& json) {
+        json += R"({"pid":)";
+        append_int(json, pid);
+        json += R"(,"ppid":)";
+        append_int(json, ppid);
+        json += '}';
+    });
 }
 
 static void log_process_end() {
-    std::string ts = now_ns();
-    std::string operation = "END_PROCESS";
-    std::string json = "{}";
-    add_event(operation, ts, json);
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        add_record(Call::EndProcess, RecordLayout::Empty, ts);
+        return;
+    }
+    add_event(Call::EndProcess, ts,
+              [](std::string& json) { json += "{}"; });
+}
+
+// Runs on each buffer during the exit flush: closes the open run and records
+// how many events the memory cap cost this thread.
+static void finish_thread_buffer(ThreadBuffer* buffer) {
+    emit_run(buffer);
+    if (!buffer->dropped_events) return;
+    uint64_t ts = now_ts();
+    if (binary_events()) {
+        append_record(buffer, Call::Dropped, RecordLayout::Dropped, ts,
+                      buffer->dropped_events);
+        return;
+    }
+    append_event(buffer, Call::Dropped, ts, [&](std::string& json) {
+        json += R"({"events":)";
+        append_uint(json, buffer->dropped_events);
+        json += '}';
+    });
+}
+
+// Process totals of the thread counters, summed during the exit flush.
+static uint64_t overhead_events = 0;
+static uint64_t overhead_dropped = 0;
+static HookCost overhead_hooks[static_cast<size_t>(Call::Count)];
+
+static void add_thread_overhead(const ThreadBuffer* buffer) {
+    overhead_events += buffer->recorded_events;
+    overhead_dropped += buffer->dropped_events;
+    for (size_t i = 0; i < std::size(overhead_hooks); i++) {
+        overhead_hooks[i].calls += buffer->hook_costs[i].calls;
+        overhead_hooks[i].log_ns += buffer->hook_costs[i].log_ns;
+    }
+}
+
+// One summary per process of what tracing cost it: events recorded and
+// dropped, and for each hook that ran its calls and logging time. Recording
+// has stopped by now, so the calling thread's buffer is written directly.
+static void log_overhead() {
+    ThreadBuffer* buffer = local_thread_buffer;
+    if (!buffer) buffer = register_thread_buffer();
+    uint64_t ts = now_ts();
+    uint64_t hooks = 0;
+    for (const HookCost& cost : overhead_hooks) hooks += cost.calls != 0;
+    if (binary_events()) {
+        RecordWriter record(buffer->data, Call::Overhead,
+                            RecordLayout::Overhead, current_pid(),
+                            buffer->tid, ts);
+        record.u64(overhead_events);
+        record.u64(overhead_dropped);
+        record.u64(hooks);
+        for (size_t i = 0; i < std::size(overhead_hooks); i++) {
+            if (!overhead_hooks[i].calls) continue;
+            record.u64(i);
+            record.u64(overhead_hooks[i].calls);
+            record.u64(overhead_hooks[i].log_ns);
+        }
+    } else {
+        append_event(buffer, Call::Overhead, ts, [&](std::string& json) {
+            json += R"({"events":)";
+            append_uint(json, overhead_events);
+            json += R"(,"dropped":)";
+            append_uint(json, overhead_dropped);
+            json += R"(,"hooks":[)";
+            const char* separator = "";
+            for (size_t i = 0; i < std::size(overhead_hooks); i++) {
+                if (!overhead_hooks[i].calls) continue;
+                json += separator;
+                json += R"({"call":")";
+                json += call_name(static_cast<Call>(i));
+                json += R"(","calls":)";
+                append_uint(json, overhead_hooks[i].calls);
+                json += R"(,"log_ns":)";
+                append_uint(json, overhead_hooks[i].log_ns);
+                json += "}";
+                separator = ",";
+            }
+            json += "]}";
+        });
+    }
+    write_events(buffer);
+}
+
+// Process totals of the thread latency histograms, allocated at startup.
+static PathLatencies process_latencies;
+
+// The process's latency totals, written like the overhead summary after
+// recording has stopped.
+static void log_latencies() {
+    ThreadBuffer* buffer = local_thread_buffer;
+    if (!buffer) buffer = register_thread_buffer();
+    append_latencies(buffer, process_latencies, now_ts());
+    write_events(buffer);
+}
+
+static void add_thread_latencies(const ThreadBuffer* buffer) {
+    buffer->latencies.for_each([](const InternedPath* path,
+                                  const PathLatency& latency) {
+        PathLatency* total = process_latencies.find_or_add(path);
+        if (!total) {
+            // Full: the totals so far go out, and the receiver adds up the
+            // records of one path.
+            log_latencies();
+            process_latencies.clear();
+            total = process_latencies.find_or_add(path);
+        }
+        for (int kind = 0; kind < io_kind_count; kind++)
+            total->kinds[kind].merge(latency.kinds[kind]);
+    });
 }
 
 static void save_events_clean() {
-    std::string all_events;
-    size_t total_size = 0;
-    for (const auto& event : aggregated_events) {
-        total_size += event.size();
-    }
-    all_events.reserve(total_size);
-    for (const auto& event : aggregated_events) {
-        all_events.append(event.data(), event.size());
-    }
-    std::string path_write = get_env("PROV_PATH_WRITE") + "/"
-                             + std::to_string(getpid()) + ".jsonl";
-    int fd = syscall(SYS_open, path_write.c_str(),
-                     O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd >= 0) {
-        syscall(SYS_write, fd, all_events.data(), all_events.size());
-        syscall(SYS_close, fd);
+    flush_thread_buffers([](ThreadBuffer* buffer) {
+        finish_thread_buffer(buffer);
+        if (hook_stats) add_thread_overhead(buffer);
+        if (latency_profiling) add_thread_latencies(buffer);
+        if (summary_events) add_thread_summaries(buffer);
+        write_events(buffer);
+    });
+    if (summary_events) log_summary();
+    if (latency_profiling) log_latencies();
+    if (hook_stats) log_overhead();
+}
+
+// _exit and _Exit skip the destructors, so the exit flush runs in the hook.
+static void save_events_at_exit() {
+    if (file_hashing) log_open_file_digests();
+    save_events_clean();
+}
+
+static size_t env_size(const char* name, size_t fallback) {
+    const char* val = std::getenv(name);
+    return val && *val ? strtoull(val, nullptr, 10) : fallback;
+}
+
+// The next definition of every hooked function, generated from hooks.def.
+struct RealFunctions {
+#define PROV_HOOK(kind, name, type, params, args, call) type(*name) params;
+#include "hooks.def"
+#undef PROV_HOOK
+};
+
+static RealFunctions real;
+static bool real_resolved = false;
+
+static void* resolve_real(const char* name) {
+    char libc_name[64] = "__libc_";
+    strncat(libc_name, name, sizeof(libc_name) - sizeof("__libc_"));
+    void* symbol = dlsym(RTLD_NEXT, libc_name);
+    return symbol ? symbol : dlsym(RTLD_NEXT, name);
+}
+
+// Resolves the whole table once, so hooks only test for a missing symbol.
+static void resolve_real_functions() {
+    if (real_resolved) return;
+#define PROV_HOOK(kind, name, type, params, args, call) \
+    real.name = reinterpret_cast<decltype(real.name)>(resolve_real(#name));
+#include "hooks.def"
+#undef PROV_HOOK
+    real_resolved = true;
+}
+
+// Hooks can run before the constructor, from other libraries' constructors.
+#define REQUIRE_REAL(name, fail)           \
+    if (__builtin_expect(!real.name, 0)) { \
+        resolve_real_functions();          \
+        if (!real.name) return fail;       \
     }
+
+// Holds the spool and path table locks across fork, so neither is inherited
+// mid-update, and starts the child on empty buffers under its own pid.
+static void prepare_fork() {
+    spool_mutex.lock();
+    lock_path_table();
+}
+
+static void parent_after_fork() {
+    unlock_path_table();
+    spool_mutex.unlock();
+}
+
+static void child_after_fork() {
+    unlock_path_table();
+    spool_mutex.unlock();
+    process_pid = getpid();
+    reset_thread_buffers_after_fork();
+    reset_file_hashes_after_fork();
+    log_process_start();
 }
 
 __attribute__((constructor)) static void preload_init(void) {
+    resolve_real_functions();
+    process_pid = getpid();
+    if (get_env("PROV_FORMAT") == "binary") event_format = EventFormat::Binary;
+    coalesce_events = get_env("PROV_COALESCE") == "1";
+    std::string spool_mode = get_env("PROV_SPOOL");
+    mapped_spool = spool_mode != "stream" && spool_mode != "shared";
+    hook_stats = get_env("PROV_STATS") == "1";
+    latency_profiling = get_env("PROV_LATENCY") == "1";
+    if (latency_profiling) {
+        buffer_limits.latency_paths = thread_latency_paths;
+        process_latencies.reserve(process_latency_paths);
+    }
+    summary_events = get_env("PROV_SUMMARY") == "1";
+    if (summary_events) {
+        buffer_limits.summary_paths = thread_summary_paths;
+        process_summaries.reserve(process_summary_paths);
+    }
+    compress_spool = get_env("PROV_COMPRESS") == "lz4";
+    file_hashing = get_env("PROV_HASH") == "1";
+    buffer_limits.flush_bytes
+        = env_size("PROV_FLUSH_BYTES", buffer_limits.flush_bytes);
+    buffer_limits.cap_bytes
+        = env_size("PROV_BUFFER_CAP", buffer_limits.cap_bytes);
+    if (get_env("PROV_DROP_POLICY") == "oldest")
+        buffer_limits.drop_policy = DropPolicy::Oldest;
+    clock_source = clock_source_from(get_env("PROV_CLOCK"));
+    load_op_policy();
+    load_fd_policy();
+    // Inherited descriptors are never seen opened.
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+        remember_fd(fd);
+        // An output redirected to a fresh file is hashed from here.
+        if (file_hashing) start_file_hash(fd);
+    }
+    map_event_ring();
+    if (spool_mode == "shared") map_shared_spool();
+    pthread_atfork(prepare_fork, parent_after_fork, child_after_fork);
+    if (clock_source != ClockSource::Realtime) log_clock_anchor();
     log_process_start();
 }
 
 __attribute__((destructor)) static void preload_fini(void) {
+    if (file_hashing) log_open_file_digests();
     log_process_end();
     save_events_clean();
 }
@@ -307,292 +1541,184 @@ static inline const struct sockaddr* mmsg0_name_sa(const struct mmsghdr* vec,
     return (const struct sockaddr*)vec[0].msg_hdr.msg_name;
 }
 
+// Hook bodies for the non-Custom kinds in hooks.def: call through, then log
+// with errno preserved. Calls made from inside logging only call through.
+#define PROV_HOOK_BODY(name, type, params, args, log)               \
+    type name params {                                              \
+        REQUIRE_REAL(name, -1);                                     \
+        if (__builtin_expect(in_logging, 0)) return real.name args; \
+        type ret = real.name args;                                  \
+        int saved_errno = errno;                                    \
+        log;                                                        \
+        errno = saved_errno;                                        \
+        return ret;                                                 \
+    }
+// The fd kinds also time the real call when profiling latency.
+#define PROV_HOOK_IO_BODY(name, type, params, args, io, io_fd, log)      \
+    type name params {                                                   \
+        REQUIRE_REAL(name, -1);                                          \
+        if (__builtin_expect(in_logging, 0)) return real.name args;      \
+        uint64_t io_start = latency_start();                             \
+        type ret = real.name args;                                       \
+        int saved_errno = errno;                                         \
+        if (latency_profiling)                                           \
+            note_latency(static_cast<int>(io_fd), IoKind::io, io_start); \
+        log;                                                             \
+        errno = saved_errno;                                             \
+        return ret;                                                      \
+    }
+#define PROV_HOOK_WriteFd(name, type, params, args, call)                    \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd,                   \
+                      log_output_event_fd(Call::call, fd, transferred(ret)))
+#define PROV_HOOK_WriteBuf(name, type, params, args, call)                   \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd,                   \
+                      if (file_hashing)                                      \
+                          hash_written(fd, buf, transferred(ret));           \
+                      log_output_event_fd(Call::call, fd, transferred(ret)))
+#define PROV_HOOK_WriteIov(name, type, params, args, call)                   \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd,                   \
+                      if (file_hashing) hash_written_iov(fd, iov, iovcnt,    \
+                                                         transferred(ret));  \
+                      log_output_event_fd(Call::call, fd, transferred(ret)))
+#define PROV_HOOK_PwriteBuf(name, type, params, args, call)                  \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd,                   \
+                      if (file_hashing) hash_written_at(fd, buf,             \
+                                                        transferred(ret),    \
+                                                        offset);             \
+                      log_output_event_fd(Call::call, fd, transferred(ret)))
+#define PROV_HOOK_PwriteIov(name, type, params, args, call)                  \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd,                   \
+                      if (file_hashing)                                      \
+                          hash_written_iov_at(fd, iov, iovcnt,               \
+                                              transferred(ret), offset);     \
+                      log_output_event_fd(Call::call, fd, transferred(ret)))
+#define PROV_HOOK_ReadFd(name, type, params, args, call)                   \
+    PROV_HOOK_IO_BODY(name, type, params, args, Read, fd,                  \
+                      log_input_event_fd(Call::call, static_cast<int>(fd), \
+                                         transferred(ret)))
+#define PROV_HOOK_TransferFd(name, type, params, args, call)           \
+    PROV_HOOK_IO_BODY(name, type, params, args, Write, fd_out,         \
+                      if (file_hashing) break_file_hash(fd_out);       \
+                      log_transfer_event_fd(Call::call, fd_in, fd_out, \
+                                            transferred(ret)))
+#define PROV_HOOK_PathIn(name, type, params, args, call) \
+    PROV_HOOK_BODY(name, type, params, args,             \
+                   log_input_event(Call::call, path ? path : ""))
+#define PROV_HOOK_PathOut(name, type, params, args, call) \
+    PROV_HOOK_BODY(name, type, params, args,              \
+                   log_output_event(Call::call, path ? path : ""))
+#define PROV_HOOK_PathInOut(name, type, params, args, call)                \
+    PROV_HOOK_BODY(name, type, params, args,                               \
+                   log_input_output_event(Call::call, path_in ? path_in : "", \
+                                          path_out ? path_out : ""))
+#define PROV_HOOK_Custom(name, type, params, args, call)
+
 extern "C" {
 // ---------- WRITE HOOKS ----------
-ssize_t write(int fd, const void* buf, size_t count) {
-    static ssize_t (*real_write)(int, const void*, size_t) = nullptr;
-    if (!real_write) {
-        real_write = (ssize_t (*)(int, const void*, size_t))dlsym(
-            RTLD_NEXT, "__libc_write");
-        if (!real_write) {
-            real_write = (ssize_t (*)(int, const void*, size_t))dlsym(RTLD_NEXT,
-                                                                      "write");
-        }
-        if (!real_write) return -1;
-    }
-    ssize_t ret = real_write(fd, buf, count);
-    int saved_errno = errno;
-    log_output_event_fd("WRITE", fd);
-    errno = saved_errno;
-    return ret;
-}
-
 size_t fwrite(const void* ptr, size_t size, size_t nmemb, FILE* stream) {
-    static size_t (*real_fwrite)(const void*, size_t, size_t, FILE*) = nullptr;
-    if (!real_fwrite) {
-        real_fwrite = (size_t (*)(const void*, size_t, size_t, FILE*))dlsym(
-            RTLD_NEXT, "__libc_fwrite");
-        if (!real_fwrite) {
-            real_fwrite = (size_t (*)(const void*, size_t, size_t, FILE*))dlsym(
-                RTLD_NEXT, "fwrite");
-        }
-        if (!real_fwrite) return 0;
-    }
-    size_t ret = real_fwrite(ptr, size, nmemb, stream);
+    REQUIRE_REAL(fwrite, 0);
+    size_t ret = real.fwrite(ptr, size, nmemb, stream);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FWRITE", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
-    static ssize_t (*real_writev)(int, const struct iovec*, int) = nullptr;
-    if (!real_writev) {
-        real_writev = (ssize_t (*)(int, const struct iovec*, int))dlsym(
-            RTLD_NEXT, "__libc_writev");
-        if (!real_writev) {
-            real_writev = (ssize_t (*)(int, const struct iovec*, int))dlsym(
-                RTLD_NEXT, "writev");
-        }
-        if (!real_writev) return -1;
-    }
-    ssize_t ret = real_writev(fd, iov, iovcnt);
-    int saved_errno = errno;
-    log_output_event_fd("WRITEV", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
-    static ssize_t (*real_pwrite)(int, const void*, size_t, off_t) = nullptr;
-    if (!real_pwrite) {
-        real_pwrite = (ssize_t (*)(int, const void*, size_t, off_t))dlsym(
-            RTLD_NEXT, "__libc_pwrite");
-        if (!real_pwrite) {
-            real_pwrite = (ssize_t (*)(int, const void*, size_t, off_t))dlsym(
-                RTLD_NEXT, "pwrite");
-        }
-        if (!real_pwrite) return -1;
-    }
-    ssize_t ret = real_pwrite(fd, buf, count, offset);
-    int saved_errno = errno;
-    log_output_event_fd("PWRITE", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pwrite64(int fd, const void* buf, size_t count, off64_t offset) {
-    static ssize_t (*real_pwrite64)(int, const void*, size_t, off64_t)
-        = nullptr;
-    if (!real_pwrite64) {
-        real_pwrite64 = (ssize_t (*)(int, const void*, size_t, off64_t))dlsym(
-            RTLD_NEXT, "__libc_pwrite64");
-        if (!real_pwrite64) {
-            real_pwrite64 = (ssize_t (*)(int, const void*, size_t,
-                                         off64_t))dlsym(RTLD_NEXT, "pwrite64");
-        }
-        if (!real_pwrite64) return -1;
-    }
-    ssize_t ret = real_pwrite64(fd, buf, count, offset);
-    int saved_errno = errno;
-    log_output_event_fd("PWRITE64", fd);
+    if (file_hashing) hash_written(fd, ptr, ret * size);
+    log_output_event_fd(Call::Fwrite, fd, ret * size);
     errno = saved_errno;
     return ret;
 }
 
 int fputs(const char* s, FILE* stream) {
-    static int (*real_fputs)(const char*, FILE*) = nullptr;
-    if (!real_fputs) {
-        real_fputs
-            = (int (*)(const char*, FILE*))dlsym(RTLD_NEXT, "__libc_fputs");
-        if (!real_fputs) {
-            real_fputs = (int (*)(const char*, FILE*))dlsym(RTLD_NEXT, "fputs");
-        }
-        if (!real_fputs) return -1;
-    }
-    int ret = real_fputs(s, stream);
+    REQUIRE_REAL(fputs, -1);
+    int ret = real.fputs(s, stream);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FPUTS", fd);
+    if (file_hashing && ret >= 0) hash_written(fd, s, strlen(s));
+    log_output_event_fd(Call::Fputs, fd, ret >= 0 ? strlen(s) : 0);
     errno = saved_errno;
     return ret;
 }
 
 int fprintf(FILE* stream, const char* fmt, ...) {
-    static int (*real_vfprintf)(FILE*, const char*, va_list) = nullptr;
-    if (!real_vfprintf) {
-        real_vfprintf = (int (*)(FILE*, const char*, va_list))dlsym(
-            RTLD_NEXT, "__libc_vfprintf");
-        if (!real_vfprintf) {
-            real_vfprintf = (int (*)(FILE*, const char*, va_list))dlsym(
-                RTLD_NEXT, "vfprintf");
-        }
-        if (!real_vfprintf) return -1;
-    }
+    REQUIRE_REAL(vfprintf, -1);
     va_list ap;
     va_start(ap, fmt);
-    int ret = real_vfprintf(stream, fmt, ap);
+    int ret = real.vfprintf(stream, fmt, ap);
     va_end(ap);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FPRINTF", fd);
+    // Formatted output is never seen as bytes.
+    if (file_hashing && ret > 0) break_file_hash(fd);
+    log_output_event_fd(Call::Fprintf, fd, transferred(ret));
     errno = saved_errno;
     return ret;
 }
 
 int vfprintf(FILE* stream, const char* fmt, va_list ap) {
-    static int (*real_vfprintf)(FILE*, const char*, va_list) = nullptr;
-    if (!real_vfprintf) {
-        real_vfprintf = (int (*)(FILE*, const char*, va_list))dlsym(
-            RTLD_NEXT, "__libc_vfprintf");
-        if (!real_vfprintf) {
-            real_vfprintf = (int (*)(FILE*, const char*, va_list))dlsym(
-                RTLD_NEXT, "vfprintf");
-        }
-        if (!real_vfprintf) return -1;
-    }
-    int ret = real_vfprintf(stream, fmt, ap);
+    REQUIRE_REAL(vfprintf, -1);
+    int ret = real.vfprintf(stream, fmt, ap);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("VFPRINTF", fd);
+    if (file_hashing && ret > 0) break_file_hash(fd);
+    log_output_event_fd(Call::Vfprintf, fd, transferred(ret));
     errno = saved_errno;
     return ret;
 }
 
 int dprintf(int fd, const char* fmt, ...) {
-    static int (*real_vdprintf)(int, const char*, va_list) = nullptr;
-    if (!real_vdprintf) {
-        real_vdprintf = (int (*)(int, const char*, va_list))dlsym(
-            RTLD_NEXT, "__libc_vdprintf");
-        if (!real_vdprintf) {
-            real_vdprintf = (int (*)(int, const char*, va_list))dlsym(
-                RTLD_NEXT, "vdprintf");
-        }
-        if (!real_vdprintf) return -1;
-    }
+    REQUIRE_REAL(vdprintf, -1);
     va_list ap;
     va_start(ap, fmt);
-    int ret = real_vdprintf(fd, fmt, ap);
+    int ret = real.vdprintf(fd, fmt, ap);
     va_end(ap);
     int saved_errno = errno;
-    log_output_event_fd("DPRINTF", fd);
+    if (file_hashing && ret > 0) break_file_hash(fd);
+    log_output_event_fd(Call::Dprintf, fd, transferred(ret));
     errno = saved_errno;
     return ret;
 }
 
 int vdprintf(int fd, const char* fmt, va_list ap) {
-    static int (*real_vdprintf)(int, const char*, va_list) = nullptr;
-    if (!real_vdprintf) {
-        real_vdprintf = (int (*)(int, const char*, va_list))dlsym(
-            RTLD_NEXT, "__libc_vdprintf");
-        if (!real_vdprintf) {
-            real_vdprintf = (int (*)(int, const char*, va_list))dlsym(
-                RTLD_NEXT, "vdprintf");
-        }
-        if (!real_vdprintf) return -1;
-    }
-    int ret = real_vdprintf(fd, fmt, ap);
+    REQUIRE_REAL(vdprintf, -1);
+    int ret = real.vdprintf(fd, fmt, ap);
     int saved_errno = errno;
-    log_output_event_fd("VDPRINTF", fd);
+    if (file_hashing && ret > 0) break_file_hash(fd);
+    log_output_event_fd(Call::Vdprintf, fd, transferred(ret));
     errno = saved_errno;
     return ret;
 }
 
 int fputc(int c, FILE* stream) {
-    static int (*real_fputc)(int, FILE*) = nullptr;
-    if (!real_fputc) {
-        real_fputc = (int (*)(int, FILE*))dlsym(RTLD_NEXT, "__libc_fputc");
-        if (!real_fputc) {
-            real_fputc = (int (*)(int, FILE*))dlsym(RTLD_NEXT, "fputc");
-        }
-        if (!real_fputc) return -1;
-    }
-    int ret = real_fputc(c, stream);
+    REQUIRE_REAL(fputc, -1);
+    int ret = real.fputc(c, stream);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FPUTC", fd);
+    if (file_hashing && ret != EOF) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        hash_written(fd, &byte, 1);
+    }
+    log_output_event_fd(Call::Fputc, fd, ret != EOF ? 1 : 0);
     errno = saved_errno;
     return ret;
 }
 
 int fputs_unlocked(const char* s, FILE* stream) {
-    static int (*real_fputs_unlocked)(const char*, FILE*) = nullptr;
-    if (!real_fputs_unlocked) {
-        real_fputs_unlocked = (int (*)(const char*, FILE*))dlsym(
-            RTLD_NEXT, "__libc_fputs_unlocked");
-        if (!real_fputs_unlocked) {
-            real_fputs_unlocked = (int (*)(const char*, FILE*))dlsym(
-                RTLD_NEXT, "fputs_unlocked");
-        }
-        if (!real_fputs_unlocked) return -1;
-    }
-    int ret = real_fputs_unlocked(s, stream);
+    REQUIRE_REAL(fputs_unlocked, -1);
+    int ret = real.fputs_unlocked(s, stream);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FPUTS_UNLOCKED", fd);
+    if (file_hashing && ret >= 0) hash_written(fd, s, strlen(s));
+    log_output_event_fd(Call::FputsUnlocked, fd, ret >= 0 ? strlen(s) : 0);
     errno = saved_errno;
     return ret;
 }
 
 size_t fwrite_unlocked(const void* ptr, size_t size, size_t nmemb,
                        FILE* stream) {
-    static size_t (*real_fwrite_unlocked)(const void*, size_t, size_t, FILE*)
-        = nullptr;
-    if (!real_fwrite_unlocked) {
-        real_fwrite_unlocked
-            = (size_t (*)(const void*, size_t, size_t, FILE*))dlsym(
-                RTLD_NEXT, "__libc_fwrite_unlocked");
-        if (!real_fwrite_unlocked) {
-            real_fwrite_unlocked
-                = (size_t (*)(const void*, size_t, size_t, FILE*))dlsym(
-                    RTLD_NEXT, "fwrite_unlocked");
-        }
-        if (!real_fwrite_unlocked) return 0;
-    }
-    size_t ret = real_fwrite_unlocked(ptr, size, nmemb, stream);
+    REQUIRE_REAL(fwrite_unlocked, 0);
+    size_t ret = real.fwrite_unlocked(ptr, size, nmemb, stream);
     int saved_errno = errno;
     int fd = stream ? fileno(stream) : -1;
-    log_output_event_fd("FWRITE_UNLOCKED", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
-    static ssize_t (*real_pwritev)(int, const struct iovec*, int, off_t)
-        = nullptr;
-    if (!real_pwritev) {
-        real_pwritev = (ssize_t (*)(int, const struct iovec*, int, off_t))dlsym(
-            RTLD_NEXT, "__libc_pwritev");
-        if (!real_pwritev) {
-            real_pwritev = (ssize_t (*)(int, const struct iovec*, int,
-                                        off_t))dlsym(RTLD_NEXT, "pwritev");
-        }
-        if (!real_pwritev) return -1;
-    }
-    ssize_t ret = real_pwritev(fd, iov, iovcnt, offset);
-    int saved_errno = errno;
-    log_output_event_fd("PWRITEV", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pwritev2(int fd, const struct iovec* iov, int iovcnt, off_t offset,
-                 int flags) {
-    static ssize_t (*real_pwritev2)(int, const struct iovec*, int, off_t, int)
-        = nullptr;
-    if (!real_pwritev2) {
-        real_pwritev2 = (ssize_t (*)(int, const struct iovec*, int, off_t,
-                                     int))dlsym(RTLD_NEXT, "__libc_pwritev2");
-        if (!real_pwritev2) {
-            real_pwritev2 = (ssize_t (*)(int, const struct iovec*, int, off_t,
-                                         int))dlsym(RTLD_NEXT, "pwritev2");
-        }
-        if (!real_pwritev2) return -1;
-    }
-    ssize_t ret = real_pwritev2(fd, iov, iovcnt, offset, flags);
-    int saved_errno = errno;
-    log_output_event_fd("PWRITEV2", fd);
+    if (file_hashing) hash_written(fd, ptr, ret * size);
+    log_output_event_fd(Call::FwriteUnlocked, fd, ret * size);
     errno = saved_errno;
     return ret;
 }
@@ -600,500 +1726,129 @@ ssize_t pwritev2(int fd, const struct iovec* iov, int iovcnt, off_t offset,
 // --------------- SEND HOOKS -----------------
 ssize_t sendto(int sockfd, const void* buf, size_t len, int flags,
                const struct sockaddr* dest_addr, socklen_t addrlen) {
-    static ssize_t (*real_sendto)(int, const void*, size_t, int,
-                                  const struct sockaddr*, socklen_t)
-        = nullptr;
-    if (!real_sendto) {
-        real_sendto = (ssize_t (*)(int, const void*, size_t, int,
-                                   const struct sockaddr*,
-                                   socklen_t))dlsym(RTLD_NEXT, "__libc_sendto");
-        if (!real_sendto) {
-            real_sendto = (ssize_t (*)(int, const void*, size_t, int,
-                                       const struct sockaddr*,
-                                       socklen_t))dlsym(RTLD_NEXT, "sendto");
-        }
-        if (!real_sendto) return -1;
-    }
-    ssize_t ret = real_sendto(sockfd, buf, len, flags, dest_addr, addrlen);
+    REQUIRE_REAL(sendto, -1);
+    ssize_t ret = real.sendto(sockfd, buf, len, flags, dest_addr, addrlen);
     int saved_errno = errno;
-    log_net_send_event("SENDTO", sockfd, dest_addr, addrlen, 1);
+    log_net_send_event(Call::Sendto, sockfd, dest_addr, addrlen, 1);
     errno = saved_errno;
     return ret;
 }
 
 ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) {
-    static ssize_t (*real_sendmsg)(int, const struct msghdr*, int) = nullptr;
-    if (!real_sendmsg) {
-        real_sendmsg = (ssize_t (*)(int, const struct msghdr*, int))dlsym(
-            RTLD_NEXT, "__libc_sendmsg");
-        if (!real_sendmsg) {
-            real_sendmsg = (ssize_t (*)(int, const struct msghdr*, int))dlsym(
-                RTLD_NEXT, "sendmsg");
-        }
-        if (!real_sendmsg) return -1;
-    }
-    ssize_t ret = real_sendmsg(sockfd, msg, flags);
+    REQUIRE_REAL(sendmsg, -1);
+    ssize_t ret = real.sendmsg(sockfd, msg, flags);
     int saved_errno = errno;
     socklen_t alen = 0;
     const struct sockaddr* sa = msg_name_sa(msg, &alen);
-    log_net_send_event("SENDMSG", sockfd, sa, alen, 1);
+    log_net_send_event(Call::Sendmsg, sockfd, sa, alen, 1);
     errno = saved_errno;
     return ret;
 }
 
 int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags) {
-    static int (*real_sendmmsg)(int, struct mmsghdr*, unsigned int, int)
-        = nullptr;
-    if (!real_sendmmsg) {
-        real_sendmmsg = (int (*)(int, struct mmsghdr*, unsigned int, int))dlsym(
-            RTLD_NEXT, "__libc_sendmmsg");
-        if (!real_sendmmsg) {
-            real_sendmmsg = (int (*)(int, struct mmsghdr*, unsigned int,
-                                     int))dlsym(RTLD_NEXT, "sendmmsg");
-        }
-        if (!real_sendmmsg) return -1;
-    }
-    int ret = real_sendmmsg(sockfd, msgvec, vlen, flags);
+    REQUIRE_REAL(sendmmsg, -1);
+    int ret = real.sendmmsg(sockfd, msgvec, vlen, flags);
     int saved_errno = errno;
     socklen_t alen = 0;
     const struct sockaddr* sa = mmsg0_name_sa(msgvec, vlen, &alen);
-    log_net_send_event("SENDMMSG", sockfd, sa, alen, vlen);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
-    static ssize_t (*real_sendfile)(int, int, off_t*, size_t) = nullptr;
-    if (!real_sendfile) {
-        real_sendfile = (ssize_t (*)(int, int, off_t*, size_t))dlsym(
-            RTLD_NEXT, "__libc_sendfile");
-        if (!real_sendfile) {
-            real_sendfile = (ssize_t (*)(int, int, off_t*, size_t))dlsym(
-                RTLD_NEXT, "sendfile");
-        }
-        if (!real_sendfile) return -1;
-    }
-    ssize_t ret = real_sendfile(out_fd, in_fd, offset, count);
-    int saved_errno = errno;
-    log_input_output_event_fd("SENDFILE", in_fd, out_fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t sendfile64(int out_fd, int in_fd, off64_t* offset, size_t count) {
-    static ssize_t (*real_sendfile64)(int, int, off64_t*, size_t) = nullptr;
-    if (!real_sendfile64) {
-        real_sendfile64 = (ssize_t (*)(int, int, off64_t*, size_t))dlsym(
-            RTLD_NEXT, "__libc_sendfile64");
-        if (!real_sendfile64) {
-            real_sendfile64 = (ssize_t (*)(int, int, off64_t*, size_t))dlsym(
-                RTLD_NEXT, "sendfile64");
-        }
-        if (!real_sendfile64) return -1;
-    }
-    ssize_t ret = real_sendfile64(out_fd, in_fd, offset, count);
-    int saved_errno = errno;
-    log_input_output_event_fd("SENDFILE64", in_fd, out_fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t copy_file_range(int fd_in, off64_t* off_in, int fd_out,
-                        off64_t* off_out, size_t len, unsigned int flags) {
-    static ssize_t (*real_copy_file_range)(int, off64_t*, int, off64_t*, size_t,
-                                           unsigned int)
-        = nullptr;
-    if (!real_copy_file_range) {
-        real_copy_file_range = (ssize_t (*)(
-            int, off64_t*, int, off64_t*, size_t,
-            unsigned int))dlsym(RTLD_NEXT, "__libc_copy_file_range");
-        if (!real_copy_file_range) {
-            real_copy_file_range = (ssize_t (*)(
-                int, off64_t*, int, off64_t*, size_t,
-                unsigned int))dlsym(RTLD_NEXT, "copy_file_range");
-        }
-        if (!real_copy_file_range) return -1;
-    }
-    ssize_t ret
-        = real_copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
-    int saved_errno = errno;
-    log_input_output_event_fd("COPY_FILE_RANGE", fd_in, fd_out);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t splice(int fd_in, off64_t* off_in, int fd_out, off64_t* off_out,
-               size_t len, unsigned int flags) {
-    static ssize_t (*real_splice)(int, off64_t*, int, off64_t*, size_t,
-                                  unsigned int)
-        = nullptr;
-    if (!real_splice) {
-        real_splice
-            = (ssize_t (*)(int, off64_t*, int, off64_t*, size_t,
-                           unsigned int))dlsym(RTLD_NEXT, "__libc_splice");
-        if (!real_splice) {
-            real_splice = (ssize_t (*)(int, off64_t*, int, off64_t*, size_t,
-                                       unsigned int))dlsym(RTLD_NEXT, "splice");
-        }
-        if (!real_splice) return -1;
-    }
-    ssize_t ret = real_splice(fd_in, off_in, fd_out, off_out, len, flags);
-    int saved_errno = errno;
-    log_input_output_event_fd("SPLICE", fd_in, fd_out);
+    log_net_send_event(Call::Sendmmsg, sockfd, sa, alen, vlen);
     errno = saved_errno;
     return ret;
 }
 
 // --------------------- READ HOOKS -----------------------
-ssize_t read(int fd, void* buf, size_t count) {
-    static ssize_t (*real_read)(int, void*, size_t) = nullptr;
-    if (!real_read) {
-        real_read
-            = (ssize_t (*)(int, void*, size_t))dlsym(RTLD_NEXT, "__libc_read");
-        if (!real_read) {
-            real_read
-                = (ssize_t (*)(int, void*, size_t))dlsym(RTLD_NEXT, "read");
-        }
-        if (!real_read) return -1;
-    }
-    ssize_t ret = real_read(fd, buf, count);
-    int saved_errno = errno;
-    log_input_event_fd("READ", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
-    static ssize_t (*real_pread)(int, void*, size_t, off_t) = nullptr;
-    if (!real_pread) {
-        real_pread = (ssize_t (*)(int, void*, size_t, off_t))dlsym(
-            RTLD_NEXT, "__libc_pread");
-        if (!real_pread) {
-            real_pread = (ssize_t (*)(int, void*, size_t, off_t))dlsym(
-                RTLD_NEXT, "pread");
-        }
-        if (!real_pread) return -1;
-    }
-    ssize_t ret = real_pread(fd, buf, count, offset);
-    int saved_errno = errno;
-    log_input_event_fd("PREAD", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t pread64(int fd, void* buf, size_t count, off64_t offset) {
-    static ssize_t (*real_pread64)(int, void*, size_t, off64_t) = nullptr;
-    if (!real_pread64) {
-        real_pread64 = (ssize_t (*)(int, void*, size_t, off64_t))dlsym(
-            RTLD_NEXT, "__libc_pread64");
-        if (!real_pread64) {
-            real_pread64 = (ssize_t (*)(int, void*, size_t, off64_t))dlsym(
-                RTLD_NEXT, "pread64");
-        }
-        if (!real_pread64) return -1;
-    }
-    ssize_t ret = real_pread64(fd, buf, count, offset);
-    int saved_errno = errno;
-    log_input_event_fd("PREAD64", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
-    static ssize_t (*real_readv)(int, const struct iovec*, int) = nullptr;
-    if (!real_readv) {
-        real_readv = (ssize_t (*)(int, const struct iovec*, int))dlsym(
-            RTLD_NEXT, "__libc_readv");
-        if (!real_readv) {
-            real_readv = (ssize_t (*)(int, const struct iovec*, int))dlsym(
-                RTLD_NEXT, "readv");
-        }
-        if (!real_readv) return -1;
-    }
-    ssize_t ret = real_readv(fd, iov, iovcnt);
-    int saved_errno = errno;
-    log_input_event_fd("READV", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
-    static ssize_t (*real_preadv)(int, const struct iovec*, int, off_t)
-        = nullptr;
-    if (!real_preadv) {
-        real_preadv = (ssize_t (*)(int, const struct iovec*, int, off_t))dlsym(
-            RTLD_NEXT, "__libc_preadv");
-        if (!real_preadv) {
-            real_preadv = (ssize_t (*)(int, const struct iovec*, int,
-                                       off_t))dlsym(RTLD_NEXT, "preadv");
-        }
-        if (!real_preadv) return -1;
-    }
-    ssize_t ret = real_preadv(fd, iov, iovcnt, offset);
-    int saved_errno = errno;
-    log_input_event_fd("PREADV", fd);
-    errno = saved_errno;
-    return ret;
-}
-
-ssize_t preadv2(int fd, const struct iovec* iov, int iovcnt, off_t offset,
-                int flags) {
-    static ssize_t (*real_preadv2)(int, const struct iovec*, int, off_t, int)
-        = nullptr;
-    if (!real_preadv2) {
-        real_preadv2 = (ssize_t (*)(int, const struct iovec*, int, off_t,
-                                    int))dlsym(RTLD_NEXT, "__libc_preadv2");
-        if (!real_preadv2) {
-            real_preadv2 = (ssize_t (*)(int, const struct iovec*, int, off_t,
-                                        int))dlsym(RTLD_NEXT, "preadv2");
-        }
-        if (!real_preadv2) return -1;
-    }
-    ssize_t ret = real_preadv2(fd, iov, iovcnt, offset, flags);
-    int saved_errno = errno;
-    log_input_event_fd("PREADV2", fd);
-    errno = saved_errno;
-    return ret;
-}
-
 ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags,
                  struct sockaddr* src_addr, socklen_t* addrlen) {
-    static ssize_t (*real_recvfrom)(int, void*, size_t, int, struct sockaddr*,
-                                    socklen_t*)
-        = nullptr;
-    if (!real_recvfrom) {
-        real_recvfrom
-            = (ssize_t (*)(int, void*, size_t, int, struct sockaddr*,
-                           socklen_t*))dlsym(RTLD_NEXT, "__libc_recvfrom");
-        if (!real_recvfrom) {
-            real_recvfrom
-                = (ssize_t (*)(int, void*, size_t, int, struct sockaddr*,
-                               socklen_t*))dlsym(RTLD_NEXT, "recvfrom");
-        }
-        if (!real_recvfrom) return -1;
-    }
-    ssize_t ret = real_recvfrom(sockfd, buf, len, flags, src_addr, addrlen);
+    REQUIRE_REAL(recvfrom, -1);
+    // A truncated address reports its full length; only the buffer is valid.
+    socklen_t addr_capacity = addrlen ? *addrlen : 0;
+    ssize_t ret = real.recvfrom(sockfd, buf, len, flags, src_addr, addrlen);
     int saved_errno = errno;
-    log_net_recv_event("RECVFROM", sockfd, src_addr, (addrlen ? *addrlen : 0),
-                       1);
+    log_net_recv_event(Call::Recvfrom, sockfd, src_addr,
+                       addrlen ? std::min(*addrlen, addr_capacity) : 0, 1);
     errno = saved_errno;
     return ret;
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) {
-    static ssize_t (*real_recvmsg)(int, struct msghdr*, int) = nullptr;
-    if (!real_recvmsg) {
-        real_recvmsg = (ssize_t (*)(int, struct msghdr*, int))dlsym(
-            RTLD_NEXT, "__libc_recvmsg");
-        if (!real_recvmsg) {
-            real_recvmsg = (ssize_t (*)(int, struct msghdr*, int))dlsym(
-                RTLD_NEXT, "recvmsg");
-        }
-        if (!real_recvmsg) return -1;
-    }
-    ssize_t ret = real_recvmsg(sockfd, msg, flags);
+    REQUIRE_REAL(recvmsg, -1);
+    ssize_t ret = real.recvmsg(sockfd, msg, flags);
     int saved_errno = errno;
     socklen_t alen = 0;
     const struct sockaddr* sa = msg_name_sa(msg, &alen);
-    log_net_recv_event("RECVMSG", sockfd, sa, alen, 1);
+    log_net_recv_event(Call::Recvmsg, sockfd, sa, alen, 1);
     errno = saved_errno;
     return ret;
 }
 
 int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags,
              struct timespec* timeout) {
-    static int (*real_recvmmsg)(int, struct mmsghdr*, unsigned int, int,
-                                struct timespec*)
-        = nullptr;
-    if (!real_recvmmsg) {
-        real_recvmmsg
-            = (int (*)(int, struct mmsghdr*, unsigned int, int,
-                       struct timespec*))dlsym(RTLD_NEXT, "__libc_recvmmsg");
-        if (!real_recvmmsg) {
-            real_recvmmsg
-                = (int (*)(int, struct mmsghdr*, unsigned int, int,
-                           struct timespec*))dlsym(RTLD_NEXT, "recvmmsg");
-        }
-        if (!real_recvmmsg) return -1;
-    }
-    int ret = real_recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+    REQUIRE_REAL(recvmmsg, -1);
+    int ret = real.recvmmsg(sockfd, msgvec, vlen, flags, timeout);
     int saved_errno = errno;
     socklen_t alen = 0;
     const struct sockaddr* sa = mmsg0_name_sa(msgvec, vlen, &alen);
-    log_net_recv_event("RECVMMSG", sockfd, sa, alen, vlen);
-    errno = saved_errno;
-    return ret;
-}
-
-// Directory reads
-int getdents(unsigned int fd, struct linux_dirent* dirp, unsigned int count) {
-    static int (*real_getdents)(unsigned int, struct linux_dirent*,
-                                unsigned int)
-        = nullptr;
-    if (!real_getdents) {
-        real_getdents
-            = (int (*)(unsigned int, struct linux_dirent*, unsigned int))dlsym(
-                RTLD_NEXT, "__libc_getdents");
-        if (!real_getdents) {
-            real_getdents = (int (*)(unsigned int, struct linux_dirent*,
-                                     unsigned int))dlsym(RTLD_NEXT, "getdents");
-        }
-        if (!real_getdents) return -1;
-    }
-    int ret = real_getdents(fd, dirp, count);
-    int saved_errno = errno;
-    log_input_event_fd("GETDENTS", (int)fd);
-    errno = saved_errno;
-    return ret;
-}
-
-int getdents64(unsigned int fd, struct linux_dirent64* dirp,
-               unsigned int count) {
-    static int (*real_getdents64)(unsigned int, struct linux_dirent64*,
-                                  unsigned int)
-        = nullptr;
-    if (!real_getdents64) {
-        real_getdents64
-            = (int (*)(unsigned int, struct linux_dirent64*,
-                       unsigned int))dlsym(RTLD_NEXT, "__libc_getdents64");
-        if (!real_getdents64) {
-            real_getdents64
-                = (int (*)(unsigned int, struct linux_dirent64*,
-                           unsigned int))dlsym(RTLD_NEXT, "getdents64");
-        }
-        if (!real_getdents64) return -1;
-    }
-    int ret = real_getdents64(fd, dirp, count);
-    int saved_errno = errno;
-    log_input_event_fd("GETDENTS64", (int)fd);
+    log_net_recv_event(Call::Recvmmsg, sockfd, sa, alen, vlen);
     errno = saved_errno;
     return ret;
 }
 
 // --------------------- EXEC HOOKS -----------------------
 int execve(const char* pathname, char* const argv[], char* const envp[]) {
-    static int (*real_execve)(const char*, char* const[], char* const[])
-        = nullptr;
-    if (!real_execve) {
-        real_execve = (int (*)(const char*, char* const[], char* const[]))dlsym(
-            RTLD_NEXT, "__libc_execve");
-        if (!real_execve) {
-            real_execve = (int (*)(const char*, char* const[],
-                                   char* const[]))dlsym(RTLD_NEXT, "execve");
-        }
-        if (!real_execve) return -1;
-    }
-    log_exec_event("EXECVE", pathname ? pathname : "");
-    int rc = real_execve(pathname, argv, envp);
+    REQUIRE_REAL(execve, -1);
+    log_exec_event(Call::Execve, pathname ? pathname : "");
+    int rc = real.execve(pathname, argv, envp);
     if (rc < 0)
-        log_exec_fail_event("EXECVE_FAIL", pathname ? pathname : "", errno);
+        log_exec_fail_event(Call::ExecveFail, pathname ? pathname : "", errno);
     return rc;
 }
 
 int execveat(int dirfd, const char* pathname, char* const argv[],
              char* const envp[], int flags) {
-    static int (*real_execveat)(int, const char*, char* const[], char* const[],
-                                int)
-        = nullptr;
-    if (!real_execveat) {
-        real_execveat = (int (*)(int, const char*, char* const[], char* const[],
-                                 int))dlsym(RTLD_NEXT, "__libc_execveat");
-        if (!real_execveat) {
-            real_execveat
-                = (int (*)(int, const char*, char* const[], char* const[],
-                           int))dlsym(RTLD_NEXT, "execveat");
-        }
-        if (!real_execveat) return -1;
-    }
-    log_exec_event("EXECVEAT", pathname ? pathname : "");
-    int rc = real_execveat(dirfd, pathname, argv, envp, flags);
+    REQUIRE_REAL(execveat, -1);
+    log_exec_event(Call::Execveat, pathname ? pathname : "");
+    int rc = real.execveat(dirfd, pathname, argv, envp, flags);
     if (rc < 0)
-        log_exec_fail_event("EXECVEAT_FAIL", pathname ? pathname : "", errno);
+        log_exec_fail_event(Call::ExecveatFail, pathname ? pathname : "",
+                            errno);
     return rc;
 }
 
 int fexecve(int fd, char* const argv[], char* const envp[]) {
-    static int (*real_fexecve)(int, char* const[], char* const[]) = nullptr;
-    if (!real_fexecve) {
-        real_fexecve = (int (*)(int, char* const[], char* const[]))dlsym(
-            RTLD_NEXT, "__libc_fexecve");
-        if (!real_fexecve) {
-            real_fexecve = (int (*)(int, char* const[], char* const[]))dlsym(
-                RTLD_NEXT, "fexecve");
-        }
-        if (!real_fexecve) return -1;
-    }
-    log_exec_fd_event("FEXECVE", fd);
-    int rc = real_fexecve(fd, argv, envp);
-    if (rc < 0) log_exec_fail_event("FEXECVE_FAIL", fd_path(fd), errno);
+    REQUIRE_REAL(fexecve, -1);
+    log_exec_fd_event(Call::Fexecve, fd);
+    int rc = real.fexecve(fd, argv, envp);
+    if (rc < 0) log_exec_fail_event(Call::FexecveFail, fd_path(fd), errno);
     return rc;
 }
 
 int execv(const char* path, char* const argv[]) {
-    static int (*real_execv)(const char*, char* const[]) = nullptr;
-    if (!real_execv) {
-        real_execv = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                "__libc_execv");
-        if (!real_execv) {
-            real_execv = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                    "execv");
-        }
-        if (!real_execv) return -1;
-    }
-    log_exec_event("EXECV", path ? path : "");
-    int rc = real_execv(path, argv);
-    if (rc < 0) log_exec_fail_event("EXECV_FAIL", path ? path : "", errno);
+    REQUIRE_REAL(execv, -1);
+    log_exec_event(Call::Execv, path ? path : "");
+    int rc = real.execv(path, argv);
+    if (rc < 0) log_exec_fail_event(Call::ExecvFail, path ? path : "", errno);
     return rc;
 }
 
 int execvp(const char* file, char* const argv[]) {
-    static int (*real_execvp)(const char*, char* const[]) = nullptr;
-    if (!real_execvp) {
-        real_execvp = (int (*)(const char*, char* const[]))dlsym(
-            RTLD_NEXT, "__libc_execvp");
-        if (!real_execvp) {
-            real_execvp = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                     "execvp");
-        }
-        if (!real_execvp) return -1;
-    }
-    log_exec_event("EXECPVP", file ? file : "");
-    int rc = real_execvp(file, argv);
-    if (rc < 0) log_exec_fail_event("EXECPVP_FAIL", file ? file : "", errno);
+    REQUIRE_REAL(execvp, -1);
+    log_exec_event(Call::Execvp, file ? file : "");
+    int rc = real.execvp(file, argv);
+    if (rc < 0) log_exec_fail_event(Call::ExecvpFail, file ? file : "", errno);
     return rc;
 }
 
 int execvpe(const char* file, char* const argv[], char* const envp[]) {
-    static int (*real_execvpe)(const char*, char* const[], char* const[])
-        = nullptr;
-    if (!real_execvpe) {
-        real_execvpe
-            = (int (*)(const char*, char* const[], char* const[]))dlsym(
-                RTLD_NEXT, "__libc_execvpe");
-        if (!real_execvpe) {
-            real_execvpe = (int (*)(const char*, char* const[],
-                                    char* const[]))dlsym(RTLD_NEXT, "execvpe");
-        }
-        if (!real_execvpe) return -1;
-    }
-    log_exec_event("EXECPVE", file ? file : "");
-    int rc = real_execvpe(file, argv, envp);
-    if (rc < 0) log_exec_fail_event("EXECPVE_FAIL", file ? file : "", errno);
+    REQUIRE_REAL(execvpe, -1);
+    log_exec_event(Call::Execvpe, file ? file : "");
+    int rc = real.execvpe(file, argv, envp);
+    if (rc < 0) log_exec_fail_event(Call::ExecvpeFail, file ? file : "", errno);
     return rc;
 }
 
 int execl(const char* path, const char* arg, ...) {
-    static int (*real_execv)(const char*, char* const[]) = nullptr;
-    if (!real_execv) {
-        real_execv = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                "__libc_execv");
-        if (!real_execv) {
-            real_execv = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                    "execv");
-        }
-        if (!real_execv) return -1;
-    }
-    log_exec_event("EXECL", path ? path : "");
+    REQUIRE_REAL(execv, -1);
+    log_exec_event(Call::Execl, path ? path : "");
     va_list ap;
     va_start(ap, arg);
     char** argv = build_argv_from_varargs(arg, ap);
@@ -1102,24 +1857,15 @@ int execl(const char* path, const char* arg, ...) {
         errno = ENOMEM;
         return -1;
     }
-    int rc = real_execv(path, argv);
-    if (rc < 0) log_exec_fail_event("EXECL_FAIL", path ? path : "", errno);
+    int rc = real.execv(path, argv);
+    if (rc < 0) log_exec_fail_event(Call::ExeclFail, path ? path : "", errno);
     free(argv);
     return rc;
 }
 
 int execlp(const char* file, const char* arg, ...) {
-    static int (*real_execvp)(const char*, char* const[]) = nullptr;
-    if (!real_execvp) {
-        real_execvp = (int (*)(const char*, char* const[]))dlsym(
-            RTLD_NEXT, "__libc_execvp");
-        if (!real_execvp) {
-            real_execvp = (int (*)(const char*, char* const[]))dlsym(RTLD_NEXT,
-                                                                     "execvp");
-        }
-        if (!real_execvp) return -1;
-    }
-    log_exec_event("EXECLP", file ? file : "");
+    REQUIRE_REAL(execvp, -1);
+    log_exec_event(Call::Execlp, file ? file : "");
     va_list ap;
     va_start(ap, arg);
     char** argv = build_argv_from_varargs(arg, ap);
@@ -1128,25 +1874,15 @@ int execlp(const char* file, const char* arg, ...) {
         errno = ENOMEM;
         return -1;
     }
-    int rc = real_execvp(file, argv);
-    if (rc < 0) log_exec_fail_event("EXECLP_FAIL", file ? file : "", errno);
+    int rc = real.execvp(file, argv);
+    if (rc < 0) log_exec_fail_event(Call::ExeclpFail, file ? file : "", errno);
     free(argv);
     return rc;
 }
 
 int execle(const char* path, const char* arg, ...) {
-    static int (*real_execve)(const char*, char* const[], char* const[])
-        = nullptr;
-    if (!real_execve) {
-        real_execve = (int (*)(const char*, char* const[], char* const[]))dlsym(
-            RTLD_NEXT, "__libc_execve");
-        if (!real_execve) {
-            real_execve = (int (*)(const char*, char* const[],
-                                   char* const[]))dlsym(RTLD_NEXT, "execve");
-        }
-        if (!real_execve) return -1;
-    }
-    log_exec_event("EXECLE", path ? path : "");
+    REQUIRE_REAL(execve, -1);
+    log_exec_event(Call::Execle, path ? path : "");
     va_list ap;
     va_start(ap, arg);
     char** argv = build_argv_from_varargs(arg, ap);
@@ -1156,8 +1892,8 @@ int execle(const char* path, const char* arg, ...) {
         errno = ENOMEM;
         return -1;
     }
-    int rc = real_execve(path, argv, (char* const*)envp);
-    if (rc < 0) log_exec_fail_event("EXECLE_FAIL", path ? path : "", errno);
+    int rc = real.execve(path, argv, (char* const*)envp);
+    if (rc < 0) log_exec_fail_event(Call::ExecleFail, path ? path : "", errno);
     free(argv);
     return rc;
 }
@@ -1166,26 +1902,11 @@ int posix_spawn(pid_t* pid, const char* path,
                 const posix_spawn_file_actions_t* file_actions,
                 const posix_spawnattr_t* attrp, char* const argv[],
                 char* const envp[]) {
-    static int (*real_posix_spawn)(
-        pid_t*, const char*, const posix_spawn_file_actions_t*,
-        const posix_spawnattr_t*, char* const[], char* const[])
-        = nullptr;
-    if (!real_posix_spawn) {
-        real_posix_spawn
-            = (int (*)(pid_t*, const char*, const posix_spawn_file_actions_t*,
-                       const posix_spawnattr_t*, char* const[],
-                       char* const[]))dlsym(RTLD_NEXT, "__libc_posix_spawn");
-        if (!real_posix_spawn) {
-            real_posix_spawn = (int (*)(
-                pid_t*, const char*, const posix_spawn_file_actions_t*,
-                const posix_spawnattr_t*, char* const[],
-                char* const[]))dlsym(RTLD_NEXT, "posix_spawn");
-        }
-        if (!real_posix_spawn) return -1;
-    }
-    int rc = real_posix_spawn(pid, path, file_actions, attrp, argv, envp);
+    REQUIRE_REAL(posix_spawn, -1);
+    int rc = real.posix_spawn(pid, path, file_actions, attrp, argv, envp);
     int saved_errno = errno;
-    if (rc == 0 && pid) log_spawn_event("POSIX_SPAWN", *pid, path ? path : "");
+    if (rc == 0 && pid)
+        log_spawn_event(Call::PosixSpawn, *pid, path ? path : "");
     errno = saved_errno;
     return rc;
 }
@@ -1194,173 +1915,64 @@ int posix_spawnp(pid_t* pid, const char* file,
                  const posix_spawn_file_actions_t* file_actions,
                  const posix_spawnattr_t* attrp, char* const argv[],
                  char* const envp[]) {
-    static int (*real_posix_spawnp)(
-        pid_t*, const char*, const posix_spawn_file_actions_t*,
-        const posix_spawnattr_t*, char* const[], char* const[])
-        = nullptr;
-    if (!real_posix_spawnp) {
-        real_posix_spawnp
-            = (int (*)(pid_t*, const char*, const posix_spawn_file_actions_t*,
-                       const posix_spawnattr_t*, char* const[],
-                       char* const[]))dlsym(RTLD_NEXT, "__libc_posix_spawnp");
-        if (!real_posix_spawnp) {
-            real_posix_spawnp = (int (*)(
-                pid_t*, const char*, const posix_spawn_file_actions_t*,
-                const posix_spawnattr_t*, char* const[],
-                char* const[]))dlsym(RTLD_NEXT, "posix_spawnp");
-        }
-        if (!real_posix_spawnp) return -1;
-    }
-    int rc = real_posix_spawnp(pid, file, file_actions, attrp, argv, envp);
+    REQUIRE_REAL(posix_spawnp, -1);
+    int rc = real.posix_spawnp(pid, file, file_actions, attrp, argv, envp);
     int saved_errno = errno;
-    if (rc == 0 && pid) log_spawn_event("POSIX_SPAWNP", *pid, file ? file : "");
+    if (rc == 0 && pid)
+        log_spawn_event(Call::PosixSpawnp, *pid, file ? file : "");
     errno = saved_errno;
     return rc;
 }
 
 int system(const char* command) {
-    static int (*real_system)(const char*) = nullptr;
-    if (!real_system) {
-        real_system = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_system");
-        if (!real_system) {
-            real_system = (int (*)(const char*))dlsym(RTLD_NEXT, "system");
-        }
-        if (!real_system) return -1;
-    }
-    log_input_event("SYSTEM", command ? command : "");
-    return real_system(command);
+    REQUIRE_REAL(system, -1);
+    log_input_event(Call::System, command ? command : "");
+    return real.system(command);
 }
 
 pid_t fork(void) {
-    static pid_t (*real)(void) = nullptr;
-    if (!real) {
-        real = (pid_t (*)(void))dlsym(RTLD_NEXT, "__libc_fork");
-        if (!real) {
-            real = (pid_t (*)(void))dlsym(RTLD_NEXT, "fork");
-        }
-        if (!real) return -1;
-    }
-    pid_t cpid = real();
+    REQUIRE_REAL(fork, -1);
+    pid_t cpid = real.fork();
     if (cpid > 0) {
         int saved_errno = errno;
-        log_fork_event("FORK", cpid);
+        log_fork_event(Call::Fork, cpid);
         errno = saved_errno;
     }
     return cpid;
 }
 
+// A vfork child borrows the parent's stack, so it could not return through
+// this wrapper; a real fork gives it its own memory and runs the atfork
+// handlers.
 pid_t vfork(void) {
-    static pid_t (*real)(void) = nullptr;
-    if (!real) {
-        real = (pid_t (*)(void))dlsym(RTLD_NEXT, "__libc_vfork");
-        if (!real) {
-            real = (pid_t (*)(void))dlsym(RTLD_NEXT, "vfork");
-        }
-        if (!real) return -1;
-    }
-    pid_t cpid = real();
+    REQUIRE_REAL(fork, -1);
+    pid_t cpid = real.fork();
     if (cpid > 0) {
         int saved_errno = errno;
-        log_fork_event("VFORK", cpid);
+        log_fork_event(Call::Vfork, cpid);
         errno = saved_errno;
     }
     return cpid;
 }
 
-// --------------------- RENAME HOOKS -----------------------
-int rename(const char* oldpath, const char* newpath) {
-    static int (*real_rename)(const char*, const char*) = nullptr;
-    if (!real_rename) {
-        real_rename = (int (*)(const char*, const char*))dlsym(RTLD_NEXT,
-                                                               "__libc_rename");
-        if (!real_rename) {
-            real_rename
-                = (int (*)(const char*, const char*))dlsym(RTLD_NEXT, "rename");
-        }
-        if (!real_rename) return -1;
-    }
-    int rc = real_rename(oldpath, newpath);
-    int saved_errno = errno;
-    log_input_output_event("RENAME", oldpath ? oldpath : "",
-                           newpath ? newpath : "");
-    errno = saved_errno;
-    return rc;
-}
-
-int renameat(int olddirfd, const char* oldpath, int newdirfd,
-             const char* newpath) {
-    static int (*real_renameat)(int, const char*, int, const char*) = nullptr;
-    if (!real_renameat) {
-        real_renameat = (int (*)(int, const char*, int, const char*))dlsym(
-            RTLD_NEXT, "__libc_renameat");
-        if (!real_renameat) {
-            real_renameat = (int (*)(int, const char*, int, const char*))dlsym(
-                RTLD_NEXT, "renameat");
-        }
-        if (!real_renameat) return -1;
-    }
-    int rc = real_renameat(olddirfd, oldpath, newdirfd, newpath);
-    int saved_errno = errno;
-    log_input_output_event("RENAMEAT", oldpath ? oldpath : "",
-                           newpath ? newpath : "");
-    errno = saved_errno;
-    return rc;
-}
-
-int renameat2(int olddirfd, const char* oldpath, int newdirfd,
-              const char* newpath, unsigned int flags) {
-    static int (*real_renameat2)(int, const char*, int, const char*,
-                                 unsigned int)
-        = nullptr;
-    if (!real_renameat2) {
-        real_renameat2
-            = (int (*)(int, const char*, int, const char*, unsigned int))dlsym(
-                RTLD_NEXT, "__libc_renameat2");
-        if (!real_renameat2) {
-            real_renameat2
-                = (int (*)(int, const char*, int, const char*,
-                           unsigned int))dlsym(RTLD_NEXT, "renameat2");
-        }
-        if (!real_renameat2) return -1;
-    }
-    int rc = real_renameat2(olddirfd, oldpath, newdirfd, newpath, flags);
-    int saved_errno = errno;
-    log_input_output_event("RENAMEAT2", oldpath ? oldpath : "",
-                           newpath ? newpath : "");
-    errno = saved_errno;
-    return rc;
-}
-
 // clone: minimal logging (no specialized helper yet)
 int clone(int (*fn)(void*), void* stack, int flags, void* arg, ...) {
-    static int (*real)(int (*)(void*), void*, int, void*, ...) = nullptr;
-    if (!real) {
-        real = (int (*)(int (*)(void*), void*, int, void*, ...))dlsym(
-            RTLD_NEXT, "__libc_clone");
-        if (!real) {
-            real = (int (*)(int (*)(void*), void*, int, void*, ...))dlsym(
-                RTLD_NEXT, "clone");
-        }
-        if (!real) return -1;
-    }
-    log_output_event("CLONE", "");
+    REQUIRE_REAL(clone, -1);
+    log_output_event(Call::Clone, "");
     va_list ap;
     va_start(ap, arg);
     void* ptid = va_arg(ap, void*);
     void* tls = va_arg(ap, void*);
     void* ctid = va_arg(ap, void*);
     va_end(ap);
-    return real(fn, stack, flags, arg, ptid, tls, ctid);
+    return real.clone(fn, stack, flags, arg, ptid, tls, ctid);
 }
 
 void exit(int status) {
-    static void (*real)(int) = nullptr;
-    if (!real) {
-        real = (void (*)(int))dlsym(RTLD_NEXT, "exit");
-    }
-    log_output_event("EXIT", "");
-    if (real) {
-        real(status);
+    if (!real.exit) resolve_real_functions();
+    log_output_event(Call::Exit, "");
+    if (real.exit) {
+        real.exit(status);
         __builtin_unreachable();
     }
     syscall(SYS_exit_group, status);
@@ -1368,13 +1980,11 @@ void exit(int status) {
 }
 
 void _exit(int status) {
-    static void (*real)(int) = nullptr;
-    if (!real) {
-        real = (void (*)(int))dlsym(RTLD_NEXT, "_exit");
-    }
-    log_output_event("_EXIT", "");
-    if (real) {
-        real(status);
+    if (!real._exit) resolve_real_functions();
+    log_output_event(Call::UnderscoreExit, "");
+    save_events_at_exit();
+    if (real._exit) {
+        real._exit(status);
         __builtin_unreachable();
     }
     syscall(SYS_exit, status);
@@ -1382,13 +1992,11 @@ void _exit(int status) {
 }
 
 void _Exit(int status) {
-    static void (*real)(int) = nullptr;
-    if (!real) {
-        real = (void (*)(int))dlsym(RTLD_NEXT, "_Exit");
-    }
-    log_output_event("_Exit", "");
-    if (real) {
-        real(status);
+    if (!real._Exit) resolve_real_functions();
+    log_output_event(Call::UnderscoreExitC, "");
+    save_events_at_exit();
+    if (real._Exit) {
+        real._Exit(status);
         __builtin_unreachable();
     }
     syscall(SYS_exit, status);
@@ -1396,15 +2004,13 @@ void _Exit(int status) {
 }
 
 // --------------------- OPEN/CLOSE/DUP/PIPE HOOKS ------------------
+static void remember_opened_fd(int fd) {
+    remember_fd(fd);
+    if (file_hashing) start_file_hash(fd);
+}
+
 int open(const char* pathname, int flags, ...) {
-    static int (*real)(const char*, int, ...) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "__libc_open");
-        if (!real) {
-            real = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "open");
-        }
-        if (!real) return -1;
-    }
+    REQUIRE_REAL(open, -1);
     mode_t mode = 0;
     if (flags & (O_CREAT | O_TMPFILE)) {
         va_list ap;
@@ -1412,23 +2018,16 @@ int open(const char* pathname, int flags, ...) {
         mode = va_arg(ap, mode_t);
         va_end(ap);
     }
-    int fd = real(pathname, flags, mode);
+    int fd = real.open(pathname, flags, mode);
     int saved = errno;
-    log_output_event("OPEN", pathname ? pathname : "");
+    if (fd >= 0) remember_opened_fd(fd);
+    log_output_event(Call::Open, pathname ? pathname : "");
     errno = saved;
     return fd;
 }
 
 int open64(const char* pathname, int flags, ...) {
-    static int (*real)(const char*, int, ...) = nullptr;
-    if (!real) {
-        real
-            = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "__libc_open64");
-        if (!real) {
-            real = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "open64");
-        }
-        if (!real) return -1;
-    }
+    REQUIRE_REAL(open64, -1);
     mode_t mode = 0;
     if (flags & (O_CREAT | O_TMPFILE)) {
         va_list ap;
@@ -1436,40 +2035,26 @@ int open64(const char* pathname, int flags, ...) {
         mode = va_arg(ap, mode_t);
         va_end(ap);
     }
-    int fd = real(pathname, flags, mode);
+    int fd = real.open64(pathname, flags, mode);
     int saved = errno;
-    log_output_event("OPEN64", pathname ? pathname : "");
+    if (fd >= 0) remember_opened_fd(fd);
+    log_output_event(Call::Open64, pathname ? pathname : "");
     errno = saved;
     return fd;
 }
 
 int creat(const char* pathname, mode_t mode) {
-    static int (*real)(const char*, mode_t) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, mode_t))dlsym(RTLD_NEXT, "__libc_creat");
-        if (!real) {
-            real = (int (*)(const char*, mode_t))dlsym(RTLD_NEXT, "creat");
-        }
-        if (!real) return -1;
-    }
-    int fd = real(pathname, mode);
+    REQUIRE_REAL(creat, -1);
+    int fd = real.creat(pathname, mode);
     int saved = errno;
-    log_output_event("CREAT", pathname ? pathname : "");
+    if (fd >= 0) remember_opened_fd(fd);
+    log_output_event(Call::Creat, pathname ? pathname : "");
     errno = saved;
     return fd;
 }
 
 int openat(int dirfd, const char* pathname, int flags, ...) {
-    static int (*real)(int, const char*, int, ...) = nullptr;
-    if (!real) {
-        real = (int (*)(int, const char*, int, ...))dlsym(RTLD_NEXT,
-                                                          "__libc_openat");
-        if (!real) {
-            real = (int (*)(int, const char*, int, ...))dlsym(RTLD_NEXT,
-                                                              "openat");
-        }
-        if (!real) return -1;
-    }
+    REQUIRE_REAL(openat, -1);
     mode_t mode = 0;
     if (flags & (O_CREAT | O_TMPFILE)) {
         va_list ap;
@@ -1477,494 +2062,355 @@ int openat(int dirfd, const char* pathname, int flags, ...) {
         mode = va_arg(ap, mode_t);
         va_end(ap);
     }
-    int fd = real(dirfd, pathname, flags, mode);
+    int fd = real.openat(dirfd, pathname, flags, mode);
     int saved = errno;
-    log_output_event("OPENAT", pathname ? pathname : "");
+    if (fd >= 0) remember_opened_fd(fd);
+    log_output_event(Call::Openat, pathname ? pathname : "");
     errno = saved;
     return fd;
 }
 
 int openat2(int dirfd, const char* pathname, void* how, size_t size) {
-    static int (*real)(int, const char*, void*, size_t) = nullptr;
-    if (!real) {
-        real = (int (*)(int, const char*, void*, size_t))dlsym(
-            RTLD_NEXT, "__libc_openat2");
-        if (!real) {
-            real = (int (*)(int, const char*, void*, size_t))dlsym(RTLD_NEXT,
-                                                                   "openat2");
-        }
-        if (!real) return -1;
-    }
-    int fd = real(dirfd, pathname, how, size);
+    REQUIRE_REAL(openat2, -1);
+    int fd = real.openat2(dirfd, pathname, how, size);
     int saved = errno;
-    log_output_event("OPENAT2", pathname ? pathname : "");
+    if (fd >= 0) remember_opened_fd(fd);
+    log_output_event(Call::Openat2, pathname ? pathname : "");
     errno = saved;
     return fd;
 }
 
+// stdio opens are not logged as events; they only fill the fd table so that
+// later fwrite/fputc/fclose calls resolve the stream without a readlink.
+FILE* fopen(const char* pathname, const char* mode) {
+    REQUIRE_REAL(fopen, nullptr);
+    FILE* stream = real.fopen(pathname, mode);
+    int saved = errno;
+    if (stream) remember_opened_fd(fileno(stream));
+    errno = saved;
+    return stream;
+}
+
+FILE* fopen64(const char* pathname, const char* mode) {
+    REQUIRE_REAL(fopen64, nullptr);
+    FILE* stream = real.fopen64(pathname, mode);
+    int saved = errno;
+    if (stream) remember_opened_fd(fileno(stream));
+    errno = saved;
+    return stream;
+}
+
+FILE* freopen(const char* pathname, const char* mode, FILE* stream) {
+    REQUIRE_REAL(freopen, nullptr);
+    int old_fd = stream ? fileno(stream) : -1;
+    if (file_hashing) log_file_digest(old_fd);
+    forget_fd(old_fd);
+    FILE* reopened = real.freopen(pathname, mode, stream);
+    int saved = errno;
+    if (reopened) remember_opened_fd(fileno(reopened));
+    errno = saved;
+    return reopened;
+}
+
 int close(int fd) {
-    static int (*real)(int) = nullptr;
-    if (!real) {
-        real = (int (*)(int))dlsym(RTLD_NEXT, "__libc_close");
-        if (!real) {
-            real = (int (*)(int))dlsym(RTLD_NEXT, "close");
-        }
-        if (!real) return -1;
-    }
-    std::string in = fd_path(fd);
-    const char* in_c = in.c_str();
-    int rc = real(fd);
+    REQUIRE_REAL(close, -1);
+    if (fd_skipped(fd)) {
+        forget_fd(fd);
+        return real.close(fd);
+    }
+    if (file_hashing) log_file_digest(fd);
+    const InternedPath* in = fd_path(fd);
+    forget_fd(fd);
+    int rc = real.close(fd);
     int saved = errno;
-    log_input_event("CLOSE", in);
+    log_input_event(Call::Close, in);
     errno = saved;
     return rc;
 }
 
 int close_range(unsigned int first, unsigned int last, int flags) {
-    static int (*real)(unsigned int, unsigned int, int) = nullptr;
-    if (!real) {
-        real = (int (*)(unsigned int, unsigned int, int))dlsym(
-            RTLD_NEXT, "__libc_close_range");
-        if (!real) {
-            real = (int (*)(unsigned int, unsigned int, int))dlsym(
-                RTLD_NEXT, "close_range");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(first, last, flags);
+    REQUIRE_REAL(close_range, -1);
+    if (file_hashing && !(flags & CLOSE_RANGE_CLOEXEC)) {
+        int fd = first <= INT_MAX ? next_hashed_fd(static_cast<int>(first))
+                                  : -1;
+        for (; fd >= 0 && static_cast<unsigned int>(fd) <= last;
+             fd = next_hashed_fd(fd + 1))
+            log_file_digest(fd);
+    }
+    int rc = real.close_range(first, last, flags);
     int saved = errno;
-    log_output_event("CLOSE_RANGE", "");
+    if (rc == 0 && !(flags & CLOSE_RANGE_CLOEXEC)) forget_fd_range(first, last);
+    log_output_event(Call::CloseRange, "");
     errno = saved;
     return rc;
 }
 
 int fclose(FILE* stream) {
-    static int (*real)(FILE*) = nullptr;
-    if (!real) {
-        real = (int (*)(FILE*))dlsym(RTLD_NEXT, "__libc_fclose");
-        if (!real) {
-            real = (int (*)(FILE*))dlsym(RTLD_NEXT, "fclose");
-        }
-        if (!real) return -1;
-    }
+    REQUIRE_REAL(fclose, -1);
     int fd = stream ? fileno(stream) : -1;
-    std::string in = fd_path(fd);
-    const char* in_c = in.c_str();
-    int rc = real(stream);
+    if (fd_skipped(fd)) {
+        forget_fd(fd);
+        return real.fclose(stream);
+    }
+    if (file_hashing) log_file_digest(fd);
+    const InternedPath* in = fd_path(fd);
+    forget_fd(fd);
+    int rc = real.fclose(stream);
     int saved = errno;
-    log_input_event("FCLOSE", in);
+    log_input_event(Call::Fclose, in);
     errno = saved;
     return rc;
 }
 
 int pipe(int pipefd[2]) {
-    static int (*real)(int[2]) = nullptr;
-    if (!real) {
-        real = (int (*)(int[2]))dlsym(RTLD_NEXT, "__libc_pipe");
-        if (!real) {
-            real = (int (*)(int[2]))dlsym(RTLD_NEXT, "pipe");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(pipefd);
+    REQUIRE_REAL(pipe, -1);
+    int rc = real.pipe(pipefd);
     int saved = errno;
-    if (rc == 0) log_input_output_event_fd("PIPE", pipefd[0], pipefd[1]);
+    if (rc == 0) {
+        remember_fd(pipefd[0]);
+        remember_fd(pipefd[1]);
+        log_input_output_event_fd(Call::Pipe, pipefd[0], pipefd[1]);
+    }
     errno = saved;
     return rc;
 }
 
 int pipe2(int pipefd[2], int flags) {
-    static int (*real)(int[2], int) = nullptr;
-    if (!real) {
-        real = (int (*)(int[2], int))dlsym(RTLD_NEXT, "__libc_pipe2");
-        if (!real) {
-            real = (int (*)(int[2], int))dlsym(RTLD_NEXT, "pipe2");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(pipefd, flags);
+    REQUIRE_REAL(pipe2, -1);
+    int rc = real.pipe2(pipefd, flags);
     int saved = errno;
-    if (rc == 0) log_input_output_event_fd("PIPE2", pipefd[0], pipefd[1]);
+    if (rc == 0) {
+        remember_fd(pipefd[0]);
+        remember_fd(pipefd[1]);
+        log_input_output_event_fd(Call::Pipe2, pipefd[0], pipefd[1]);
+    }
     errno = saved;
     return rc;
 }
 
 int dup(int oldfd) {
-    static int (*real)(int) = nullptr;
-    if (!real) {
-        real = (int (*)(int))dlsym(RTLD_NEXT, "__libc_dup");
-        if (!real) {
-            real = (int (*)(int))dlsym(RTLD_NEXT, "dup");
-        }
-        if (!real) return -1;
-    }
-    int newfd = real(oldfd);
+    REQUIRE_REAL(dup, -1);
+    int newfd = real.dup(oldfd);
     int saved = errno;
-    log_input_output_event_fd("DUP", oldfd, newfd);
+    if (newfd >= 0) {
+        copy_fd(oldfd, newfd);
+        if (file_hashing) copy_file_hash(oldfd, newfd);
+    }
+    log_input_output_event_fd(Call::Dup, oldfd, newfd);
     errno = saved;
     return newfd;
 }
 
 int dup2(int oldfd, int newfd) {
-    static int (*real)(int, int) = nullptr;
-    if (!real) {
-        real = (int (*)(int, int))dlsym(RTLD_NEXT, "__libc_dup2");
-        if (!real) {
-            real = (int (*)(int, int))dlsym(RTLD_NEXT, "dup2");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(oldfd, newfd);
+    REQUIRE_REAL(dup2, -1);
+    // newfd is closed by the dup if open.
+    if (file_hashing && newfd != oldfd) log_file_digest(newfd);
+    int rc = real.dup2(oldfd, newfd);
     int saved = errno;
-    log_input_output_event_fd("DUP2", oldfd, rc >= 0 ? rc : newfd);
+    if (rc >= 0 && rc != oldfd) {
+        copy_fd(oldfd, rc);
+        if (file_hashing) copy_file_hash(oldfd, rc);
+    }
+    log_input_output_event_fd(Call::Dup2, oldfd, rc >= 0 ? rc : newfd);
     errno = saved;
     return rc;
 }
 
 int dup3(int oldfd, int newfd, int flags) {
-    static int (*real)(int, int, int) = nullptr;
-    if (!real) {
-        real = (int (*)(int, int, int))dlsym(RTLD_NEXT, "__libc_dup3");
-        if (!real) {
-            real = (int (*)(int, int, int))dlsym(RTLD_NEXT, "dup3");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(oldfd, newfd, flags);
+    REQUIRE_REAL(dup3, -1);
+    if (file_hashing && newfd != oldfd) log_file_digest(newfd);
+    int rc = real.dup3(oldfd, newfd, flags);
     int saved = errno;
-    log_input_output_event_fd("DUP3", oldfd, rc >= 0 ? rc : newfd);
-    errno = saved;
-    return rc;
-}
-
-// ------------------- MMAP/MUNMAP/MSYNC HOOKS ----------------
-void* mmap(void* addr, size_t length, int prot, int flags, int fd,
-           off_t offset) {
-    static void* (*real)(void*, size_t, int, int, int, off_t) = nullptr;
-    if (!real) {
-        real = (void* (*)(void*, size_t, int, int, int, off_t))dlsym(
-            RTLD_NEXT, "__libc_mmap");
-        if (!real) {
-            real = (void* (*)(void*, size_t, int, int, int, off_t))dlsym(
-                RTLD_NEXT, "mmap");
-        }
-        if (!real) return MAP_FAILED;
+    if (rc >= 0 && rc != oldfd) {
+        copy_fd(oldfd, rc);
+        if (file_hashing) copy_file_hash(oldfd, rc);
     }
-    void* ret = real(addr, length, prot, flags, fd, offset);
-    int saved = errno;
-    log_input_event_fd("MMAP", fd);
+    log_input_output_event_fd(Call::Dup3, oldfd, rc >= 0 ? rc : newfd);
     errno = saved;
-    return ret;
+    return rc;
 }
 
-void* mmap64(void* addr, size_t length, int prot, int flags, int fd,
-             off64_t offset) {
-    static void* (*real)(void*, size_t, int, int, int, off64_t) = nullptr;
-    if (!real) {
-        real = (void* (*)(void*, size_t, int, int, int, off64_t))dlsym(
-            RTLD_NEXT, "__libc_mmap64");
-        if (!real) {
-            real = (void* (*)(void*, size_t, int, int, int, off64_t))dlsym(
-                RTLD_NEXT, "mmap64");
-        }
-        if (!real) return MAP_FAILED;
-    }
-    void* ret = real(addr, length, prot, flags, fd, offset);
+// --------------------- SOCKET/EVENTFD HOOKS ---------------------
+// Not logged as events; they only classify the new descriptors, so that
+// I/O on sockets and event fds can be skipped without a readlink.
+int socket(int domain, int type, int protocol) {
+    REQUIRE_REAL(socket, -1);
+    int fd = real.socket(domain, type, protocol);
     int saved = errno;
-    log_input_event_fd("MMAP64", fd);
+    if (fd >= 0) remember_fd(fd);
     errno = saved;
-    return ret;
+    return fd;
 }
 
-int munmap(void* addr, size_t length) {
-    static int (*real)(void*, size_t) = nullptr;
-    if (!real) {
-        real = (int (*)(void*, size_t))dlsym(RTLD_NEXT, "__libc_munmap");
-        if (!real) {
-            real = (int (*)(void*, size_t))dlsym(RTLD_NEXT, "munmap");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(addr, length);
+int socketpair(int domain, int type, int protocol, int sv[2]) {
+    REQUIRE_REAL(socketpair, -1);
+    int rc = real.socketpair(domain, type, protocol, sv);
     int saved = errno;
-    log_input_event("MUNMAP", "");
-    errno = saved;
-    return rc;
-}
-
-int msync(void* addr, size_t length, int flags) {
-    static int (*real)(void*, size_t, int) = nullptr;
-    if (!real) {
-        real = (int (*)(void*, size_t, int))dlsym(RTLD_NEXT, "__libc_msync");
-        if (!real) {
-            real = (int (*)(void*, size_t, int))dlsym(RTLD_NEXT, "msync");
-        }
-        if (!real) return -1;
+    if (rc == 0) {
+        remember_fd(sv[0]);
+        remember_fd(sv[1]);
     }
-    int rc = real(addr, length, flags);
-    int saved = errno;
-    log_input_event("MSYNC", "");
     errno = saved;
     return rc;
 }
 
-// ------------------- SIZE/SPACE METADATA HOOKS ----------------
-int ftruncate(int fd, off_t length) {
-    static int (*real)(int, off_t) = nullptr;
-    if (!real) {
-        real = (int (*)(int, off_t))dlsym(RTLD_NEXT, "__libc_ftruncate");
-        if (!real) {
-            real = (int (*)(int, off_t))dlsym(RTLD_NEXT, "ftruncate");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(fd, length);
+int accept(int sockfd, struct sockaddr* addr, socklen_t* addrlen) {
+    REQUIRE_REAL(accept, -1);
+    int fd = real.accept(sockfd, addr, addrlen);
     int saved = errno;
-    log_output_event_fd("FTRUNCATE", fd);
+    if (fd >= 0) remember_fd(fd);
     errno = saved;
-    return rc;
+    return fd;
 }
 
-int truncate(const char* path, off_t length) {
-    static int (*real)(const char*, off_t) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, off_t))dlsym(RTLD_NEXT, "__libc_truncate");
-        if (!real) {
-            real = (int (*)(const char*, off_t))dlsym(RTLD_NEXT, "truncate");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(path, length);
+int accept4(int sockfd, struct sockaddr* addr, socklen_t* addrlen,
+            int flags) {
+    REQUIRE_REAL(accept4, -1);
+    int fd = real.accept4(sockfd, addr, addrlen, flags);
     int saved = errno;
-    log_output_event("TRUNCATE", path ? path : "");
+    if (fd >= 0) remember_fd(fd);
     errno = saved;
-    return rc;
+    return fd;
 }
 
-int posix_fadvise(int fd, off_t offset, off_t len, int advice) {
-    static int (*real)(int, off_t, off_t, int) = nullptr;
-    if (!real) {
-        real = (int (*)(int, off_t, off_t, int))dlsym(RTLD_NEXT,
-                                                      "__libc_posix_fadvise");
-        if (!real) {
-            real = (int (*)(int, off_t, off_t, int))dlsym(RTLD_NEXT,
-                                                          "posix_fadvise");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(fd, offset, len, advice);
+int eventfd(unsigned int initval, int flags) {
+    REQUIRE_REAL(eventfd, -1);
+    int fd = real.eventfd(initval, flags);
     int saved = errno;
-    log_output_event_fd("POSIX_FADVISE", fd);
+    if (fd >= 0) remember_fd(fd);
     errno = saved;
-    return rc;
+    return fd;
 }
 
-int posix_fallocate(int fd, off_t offset, off_t len) {
-    static int (*real)(int, off_t, off_t) = nullptr;
-    if (!real) {
-        real = (int (*)(int, off_t, off_t))dlsym(RTLD_NEXT,
-                                                 "__libc_posix_fallocate");
-        if (!real) {
-            real = (int (*)(int, off_t, off_t))dlsym(RTLD_NEXT,
-                                                     "posix_fallocate");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(fd, offset, len);
-    int saved = errno;
-    log_output_event_fd("POSIX_FALLOCATE", fd);
-    errno = saved;
-    return rc;
+// --------------------- SEEK HOOKS ---------------------
+// Not logged as events; they only tell content hashing where the next
+// write() lands.
+off_t lseek(int fd, off_t offset, int whence) {
+    REQUIRE_REAL(lseek, -1);
+    off_t ret = real.lseek(fd, offset, whence);
+    if (file_hashing && ret >= 0) seek_file_hash(fd, ret);
+    return ret;
 }
 
-//--------------- METADATA HOOKS -------------------------
-int link(const char* oldpath, const char* newpath) {
-    static int (*real)(const char*, const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, const char*))dlsym(RTLD_NEXT,
-                                                        "__libc_link");
-        if (!real) {
-            real = (int (*)(const char*, const char*))dlsym(RTLD_NEXT, "link");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(oldpath, newpath);
-    int saved_errno = errno;
-    log_input_output_event("LINK", oldpath ? oldpath : "",
-                           newpath ? newpath : "");
-    errno = saved_errno;
-    return rc;
+off64_t lseek64(int fd, off64_t offset, int whence) {
+    REQUIRE_REAL(lseek64, -1);
+    off64_t ret = real.lseek64(fd, offset, whence);
+    if (file_hashing && ret >= 0) seek_file_hash(fd, ret);
+    return ret;
 }
 
-int linkat(int olddirfd, const char* oldpath, int newdirfd, const char* newpath,
-           int flags) {
-    static int (*real)(int, const char*, int, const char*, int) = nullptr;
-    if (!real) {
-        real = (int (*)(int, const char*, int, const char*, int))dlsym(
-            RTLD_NEXT, "__libc_linkat");
-        if (!real) {
-            real = (int (*)(int, const char*, int, const char*, int))dlsym(
-                RTLD_NEXT, "linkat");
-        }
-        if (!real) return -1;
+// A stream's position counts the bytes still in its buffer, as do the
+// stdio write hooks.
+int fseek(FILE* stream, long offset, int whence) {
+    REQUIRE_REAL(fseek, -1);
+    int rc = real.fseek(stream, offset, whence);
+    int saved = errno;
+    if (file_hashing && rc == 0) {
+        off_t position = ftello(stream);
+        if (position >= 0) seek_file_hash(fileno(stream), position);
     }
-    int rc = real(olddirfd, oldpath, newdirfd, newpath, flags);
-    int saved_errno = errno;
-    log_input_output_event("LINKAT", oldpath ? oldpath : "",
-                           newpath ? newpath : "");
-    errno = saved_errno;
+    errno = saved;
     return rc;
 }
 
-int symlink(const char* target, const char* linkpath) {
-    static int (*real)(const char*, const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, const char*))dlsym(RTLD_NEXT,
-                                                        "__libc_symlink");
-        if (!real) {
-            real = (int (*)(const char*, const char*))dlsym(RTLD_NEXT,
-                                                            "symlink");
-        }
-        if (!real) return -1;
+int fseeko(FILE* stream, off_t offset, int whence) {
+    REQUIRE_REAL(fseeko, -1);
+    int rc = real.fseeko(stream, offset, whence);
+    int saved = errno;
+    if (file_hashing && rc == 0) {
+        off_t position = ftello(stream);
+        if (position >= 0) seek_file_hash(fileno(stream), position);
     }
-    int rc = real(target, linkpath);
-    int saved_errno = errno;
-    log_input_output_event("SYMLINK", target ? target : "",
-                           linkpath ? linkpath : "");
-    errno = saved_errno;
+    errno = saved;
     return rc;
 }
 
-int symlinkat(const char* target, int newdirfd, const char* linkpath) {
-    static int (*real)(const char*, int, const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*, int, const char*))dlsym(
-            RTLD_NEXT, "__libc_symlinkat");
-        if (!real) {
-            real = (int (*)(const char*, int, const char*))dlsym(RTLD_NEXT,
-                                                                 "symlinkat");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(target, newdirfd, linkpath);
-    int saved_errno = errno;
-    log_input_output_event("SYMLINKAT", target ? target : "",
-                           linkpath ? linkpath : "");
-    errno = saved_errno;
-    return rc;
+// ------------------- MMAP/MUNMAP/MSYNC HOOKS ----------------
+void* mmap(void* addr, size_t length, int prot, int flags, int fd,
+           off_t offset) {
+    REQUIRE_REAL(mmap, MAP_FAILED);
+    void* ret = real.mmap(addr, length, prot, flags, fd, offset);
+    // Anonymous memory has no file behind it.
+    if (fd < 0 || (flags & MAP_ANONYMOUS)) return ret;
+    int saved = errno;
+    // Stores through a shared mapping bypass the write hooks.
+    if (file_hashing && ret != MAP_FAILED && (prot & PROT_WRITE)
+        && (flags & MAP_SHARED))
+        break_file_hash(fd);
+    log_input_event_fd(Call::Mmap, fd);
+    errno = saved;
+    return ret;
 }
 
-int unlink(const char* pathname) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_unlink");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "unlink");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(pathname);
-    int saved_errno = errno;
-    log_input_event("UNLINK", pathname ? pathname : "");
-    errno = saved_errno;
-    return rc;
+void* mmap64(void* addr, size_t length, int prot, int flags, int fd,
+             off64_t offset) {
+    REQUIRE_REAL(mmap64, MAP_FAILED);
+    void* ret = real.mmap64(addr, length, prot, flags, fd, offset);
+    if (fd < 0 || (flags & MAP_ANONYMOUS)) return ret;
+    int saved = errno;
+    if (file_hashing && ret != MAP_FAILED && (prot & PROT_WRITE)
+        && (flags & MAP_SHARED))
+        break_file_hash(fd);
+    log_input_event_fd(Call::Mmap64, fd);
+    errno = saved;
+    return ret;
 }
 
-int unlinkat(int dirfd, const char* pathname, int flags) {
-    static int (*real)(int, const char*, int) = nullptr;
-    if (!real) {
-        real = (int (*)(int, const char*, int))dlsym(RTLD_NEXT,
-                                                     "__libc_unlinkat");
-        if (!real) {
-            real = (int (*)(int, const char*, int))dlsym(RTLD_NEXT, "unlinkat");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(dirfd, pathname, flags);
-    int saved_errno = errno;
-    log_input_event("UNLINKAT", pathname ? pathname : "");
-    errno = saved_errno;
+int munmap(void* addr, size_t length) {
+    REQUIRE_REAL(munmap, -1);
+    int rc = real.munmap(addr, length);
+    int saved = errno;
+    log_input_event(Call::Munmap, "");
+    errno = saved;
     return rc;
 }
 
-int remove(const char* pathname) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_remove");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "remove");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(pathname);
-    int saved_errno = errno;
-    log_input_event("REMOVE", pathname ? pathname : "");
-    errno = saved_errno;
+int msync(void* addr, size_t length, int flags) {
+    REQUIRE_REAL(msync, -1);
+    int rc = real.msync(addr, length, flags);
+    int saved = errno;
+    log_input_event(Call::Msync, "");
+    errno = saved;
     return rc;
 }
 
-int rmdir(const char* pathname) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_rmdir");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "rmdir");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(pathname);
-    int saved_errno = errno;
-    log_input_event("RMDIR", pathname ? pathname : "");
-    errno = saved_errno;
+// --------------------- SYNC HOOKS ---------------------
+// Not logged as events; only timed, since a sync is where a write to a
+// parallel filesystem shows its cost.
+int fsync(int fd) {
+    REQUIRE_REAL(fsync, -1);
+    uint64_t start = latency_start();
+    int rc = real.fsync(fd);
+    int saved = errno;
+    if (latency_profiling) note_latency(fd, IoKind::Sync, start);
+    errno = saved;
     return rc;
 }
 
-// IPC name unlinks
-int shm_unlink(const char* name) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_shm_unlink");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "shm_unlink");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(name);
-    int saved_errno = errno;
-    log_input_event("SHM_UNLINK", name ? name : "");
-    errno = saved_errno;
+int fdatasync(int fd) {
+    REQUIRE_REAL(fdatasync, -1);
+    uint64_t start = latency_start();
+    int rc = real.fdatasync(fd);
+    int saved = errno;
+    if (latency_profiling) note_latency(fd, IoKind::Sync, start);
+    errno = saved;
     return rc;
 }
 
-int mq_unlink(const char* name) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_mq_unlink");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "mq_unlink");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(name);
-    int saved_errno = errno;
-    log_input_event("MQ_UNLINK", name ? name : "");
-    errno = saved_errno;
+// --------------------- SIZE HOOKS ---------------------
+int ftruncate(int fd, off_t length) {
+    REQUIRE_REAL(ftruncate, -1);
+    int rc = real.ftruncate(fd, length);
+    int saved = errno;
+    if (file_hashing && rc == 0) resize_file_hash(fd, length);
+    log_output_event_fd(Call::Ftruncate, fd);
+    errno = saved;
     return rc;
 }
 
-int sem_unlink(const char* name) {
-    static int (*real)(const char*) = nullptr;
-    if (!real) {
-        real = (int (*)(const char*))dlsym(RTLD_NEXT, "__libc_sem_unlink");
-        if (!real) {
-            real = (int (*)(const char*))dlsym(RTLD_NEXT, "sem_unlink");
-        }
-        if (!real) return -1;
-    }
-    int rc = real(name);
-    int saved_errno = errno;
-    log_input_event("SEM_UNLINK", name ? name : "");
-    errno = saved_errno;
-    return rc;
-}
+// Hooks with a generated body, see hooks.def.
+#define PROV_HOOK(kind, name, type, params, args, call) \
+    PROV_HOOK_##kind(name, type, params, args, call)
+#include "hooks.def"
+#undef PROV_HOOK
 }
@@ -0,0 +1,73 @@
+#include "op_policy.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+OpPolicy op_policy;
+
+// Events of each class seen by this thread, for deterministic sampling.
+static thread_local uint64_t op_seen[sysop_count]
+    __attribute__((tls_model("initial-exec")));
+
+static std::string_view next_item(std::string_view& rest, char separator) {
+    size_t end = rest.find(separator);
+    std::string_view item = rest.substr(0, end);
+    rest = end == std::string_view::npos ? "" : rest.substr(end + 1);
+    return item;
+}
+
+static uint64_t parse_count(std::string_view text) {
+    return strtoull(std::string(text).c_str(), nullptr, 10);
+}
+
+// Maps prov's control page read-only. Raw syscalls, as libc's open/mmap are
+// hooked.
+static const ControlPage* map_control_page(const char* path) {
+    int fd = syscall(SYS_open, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+    void* map = reinterpret_cast<void*>(syscall(
+        SYS_mmap, nullptr, sizeof(ControlPage), PROT_READ, MAP_SHARED, fd, 0));
+    syscall(SYS_close, fd);
+    if (map == MAP_FAILED) return nullptr;
+    const ControlPage* page = static_cast<const ControlPage*>(map);
+    if (std::memcmp(page->magic, control_magic, sizeof(control_magic)) != 0) {
+        syscall(SYS_munmap, map, sizeof(ControlPage));
+        return nullptr;
+    }
+    return page;
+}
+
+void load_op_policy() {
+    const char* ops = std::getenv("PROV_OPS");
+    op_policy.word.store(control_enabled | sysop_mask(ops ? ops : ""));
+    const char* control = std::getenv("PROV_CONTROL");
+    if (control && *control) {
+        if (const ControlPage* page = map_control_page(control))
+            op_policy.control = &page->word;
+    }
+    const char* sample = std::getenv("PROV_SAMPLE");
+    std::string_view rest = sample ? sample : "";
+    while (!rest.empty()) {
+        std::string_view entry = next_item(rest, ',');
+        SysOp op;
+        if (!sysop_from_name(next_item(entry, ':'), op)) continue;
+        OpSampling& sampling = op_policy.sampling[static_cast<uint8_t>(op)];
+        sampling.first = parse_count(next_item(entry, ':'));
+        sampling.every = parse_count(entry);
+        if (sampling.every) op_policy.sampled = true;
+    }
+}
+
+bool sample_op(SysOp op) {
+    const OpSampling& sampling = op_policy.sampling[static_cast<uint8_t>(op)];
+    if (!sampling.every) return true;
+    uint64_t seen = op_seen[static_cast<uint8_t>(op)]++;
+    return seen < sampling.first
+           || (seen - sampling.first) % sampling.every == 0;
+}
@@ -0,0 +1,68 @@
+#include "path_filter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct PathRule {
+    std::string prefix;  // without a trailing '/', so "/" is ""
+    bool include;
+};
+
+// Rules sorted by prefix, so each candidate prefix is a binary search.
+struct PathFilter {
+    std::vector<PathRule> rules;
+    bool include_rest = true;
+};
+
+static void add_rules(PathFilter& filter, const char* list, bool include) {
+    std::string_view rest = list ? list : "";
+    while (!rest.empty()) {
+        size_t end = rest.find(':');
+        std::string_view prefix = rest.substr(0, end);
+        rest = end == std::string_view::npos ? "" : rest.substr(end + 1);
+        if (prefix.empty() || prefix[0] != '/') continue;
+        while (!prefix.empty() && prefix.back() == '/') prefix.remove_suffix(1);
+        filter.rules.push_back({std::string(prefix), include});
+        if (include) filter.include_rest = false;
+    }
+}
+
+static PathFilter compile_path_filter() {
+    PathFilter filter;
+    const char* include = std::getenv("PROV_PATH_INCLUDE");
+    if (!include || !*include) include = std::getenv("PROV_PATH_EXEC");
+    add_rules(filter, include, true);
+    add_rules(filter, std::getenv("PROV_PATH_EXCLUDE"), false);
+    // On a duplicate prefix the exclude wins: stable order keeps it last.
+    std::stable_sort(filter.rules.begin(), filter.rules.end(),
+                     [](const PathRule& a, const PathRule& b) {
+                         return a.prefix < b.prefix;
+                     });
+    return filter;
+}
+
+static const PathFilter& path_filter() {
+    static const PathFilter filter = compile_path_filter();
+    return filter;
+}
+
+bool path_in_scope(std::string_view path) {
+    const PathFilter& filter = path_filter();
+    if (filter.rules.empty() || path.empty() || path[0] != '/') return true;
+    bool in_scope = filter.include_rest;
+    // Every component boundary, shortest first, so the longest match wins.
+    for (size_t end = 0; end <= path.size(); ++end) {
+        if (end < path.size() && path[end] != '/') continue;
+        std::string_view prefix = path.substr(0, end);
+        auto it = std::upper_bound(
+            filter.rules.begin(), filter.rules.end(), prefix,
+            [](std::string_view value, const PathRule& rule) {
+                return value < rule.prefix;
+            });
+        if (it != filter.rules.begin() && (it - 1)->prefix == prefix)
+            in_scope = (it - 1)->include;
+    }
+    return in_scope;
+}
@@ -0,0 +1,163 @@
+#include "path_table.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+
+#include "path_filter.hpp"
+
+// Open addressing with lock-free lookups and CAS inserts. Paths that find no
+// free slot within max_probe go to a mutex-guarded overflow table.
+static constexpr size_t path_slots = 1 << 16;
+static constexpr size_t max_probe = 64;
+static constexpr size_t overflow_slots = 1 << 12;
+static_assert(interned_path_limit == path_slots + overflow_slots);
+
+static std::atomic<const InternedPath*> slots[path_slots];
+static std::atomic<uint32_t> next_path_id{1};
+
+static const InternedPath* overflow[overflow_slots];
+static std::mutex overflow_mutex;
+
+// Interned entries and their bytes. The mapping is made at the first intern,
+// with raw syscalls as mmap is hooked, and only the pages used are backed.
+static constexpr size_t arena_bytes = size_t{32} << 20;
+
+// Entries of paths recorded without interning: a few per thread, reused in
+// turn, from past the end of the arena.
+static constexpr size_t scratch_entries = 4;
+static constexpr size_t scratch_path_bytes = 4096;  // PATH_MAX
+static constexpr size_t scratch_threads = 1024;
+
+struct ScratchEntry {
+    InternedPath entry;
+    char bytes[scratch_path_bytes];
+};
+struct ThreadScratch {
+    ScratchEntry entries[scratch_entries];
+    size_t next;
+};
+static constexpr size_t scratch_bytes = scratch_threads * sizeof(ThreadScratch);
+
+static std::atomic<char*> arena{nullptr};
+static std::atomic<size_t> arena_used{0};
+static std::atomic<size_t> scratch_used{0};
+static std::atomic<uint32_t> next_uninterned_id{UINT32_MAX};
+static thread_local ThreadScratch* thread_scratch
+    __attribute__((tls_model("initial-exec"))) = nullptr;
+
+// Left out of scope, and so not recorded, once even the scratch entries run
+// out.
+static const InternedPath unrecorded_path{
+    .id = 0, .hash = 0, .in_scope = false, .interned = false, .path = {}};
+
+static char* map_arena() {
+    char* base = arena.load(std::memory_order_acquire);
+    if (base) return base;
+    void* map = reinterpret_cast<void*>(
+        syscall(SYS_mmap, nullptr, arena_bytes + scratch_bytes,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (map == MAP_FAILED) return nullptr;
+    if (!arena.compare_exchange_strong(base, static_cast<char*>(map),
+                                       std::memory_order_acq_rel)) {
+        syscall(SYS_munmap, map, arena_bytes + scratch_bytes);
+        return base;
+    }
+    return static_cast<char*>(map);
+}
+
+// Returns nullptr once the arena is full.
+static const InternedPath* new_path(std::string_view path, uint64_t hash) {
+    char* base = map_arena();
+    if (!base) return nullptr;
+    size_t size = (sizeof(InternedPath) + path.size() + alignof(InternedPath)
+                   - 1)
+                  & ~(alignof(InternedPath) - 1);
+    size_t offset = arena_used.fetch_add(size, std::memory_order_relaxed);
+    if (offset + size > arena_bytes) return nullptr;
+    char* bytes = base + offset + sizeof(InternedPath);
+    std::memcpy(bytes, path.data(), path.size());
+    return new (base + offset)
+        InternedPath{.id = next_path_id.fetch_add(1),
+                     .hash = hash,
+                     .in_scope = path_in_scope(path),
+                     .interned = true,
+                     .path = std::string_view(bytes, path.size())};
+}
+
+static const InternedPath* uninterned_path(std::string_view path,
+                                           uint64_t hash) {
+    ThreadScratch* scratch = thread_scratch;
+    if (!scratch) {
+        char* base = map_arena();
+        size_t offset = scratch_used.fetch_add(sizeof(ThreadScratch),
+                                               std::memory_order_relaxed);
+        if (!base || offset + sizeof(ThreadScratch) > scratch_bytes)
+            return &unrecorded_path;
+        scratch = reinterpret_cast<ThreadScratch*>(base + arena_bytes + offset);
+        thread_scratch = scratch;
+    }
+    ScratchEntry& slot = scratch->entries[scratch->next++ % scratch_entries];
+    size_t size = std::min(path.size(), sizeof(slot.bytes));
+    std::memcpy(slot.bytes, path.data(), size);
+    slot.entry = InternedPath{.id = next_uninterned_id.fetch_sub(1),
+                              .hash = hash,
+                              .in_scope = path_in_scope(path),
+                              .interned = false,
+                              .path = std::string_view(slot.bytes, size)};
+    return &slot.entry;
+}
+
+// `created` is the caller's unpublished entry for the path, if any.
+static const InternedPath* intern_overflow(std::string_view path,
+                                           uint64_t hash,
+                                           const InternedPath* created) {
+    std::lock_guard<std::mutex> guard(overflow_mutex);
+    for (size_t probe = 0; probe < overflow_slots; ++probe) {
+        const InternedPath*& slot
+            = overflow[(hash + probe) & (overflow_slots - 1)];
+        if (!slot) {
+            slot = created ? created : new_path(path, hash);
+            return slot ? slot : uninterned_path(path, hash);
+        }
+        if (slot->hash == hash && slot->path == path) return slot;
+    }
+    return uninterned_path(path, hash);
+}
+
+const InternedPath* intern_path(std::string_view path) {
+    uint64_t hash = std::hash<std::string_view>{}(path);
+    // An entry that loses its insert race stays unused in the arena.
+    const InternedPath* created = nullptr;
+    for (size_t probe = 0; probe < max_probe; ++probe) {
+        std::atomic<const InternedPath*>& slot
+            = slots[(hash + probe) & (path_slots - 1)];
+        const InternedPath* entry = slot.load(std::memory_order_acquire);
+        if (!entry) {
+            if (!created) created = new_path(path, hash);
+            if (!created) return uninterned_path(path, hash);
+            if (slot.compare_exchange_strong(entry, created,
+                                             std::memory_order_acq_rel)) {
+                return created;
+            }
+        }
+        if (entry->hash == hash && entry->path == path) return entry;
+    }
+    return intern_overflow(path, hash, created);
+}
+
+void lock_path_table() {
+    overflow_mutex.lock();
+}
+
+void unlock_path_table() {
+    overflow_mutex.unlock();
+}
@@ -1,14 +1,35 @@
 #include <curl/curl.h>
+#include <fcntl.h>
 #include <simdjson.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <CLI/CLI.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "control_page.hpp"
+#include "event_clock.hpp"
+#include "json_escape.hpp"
+#include "latency_histogram.hpp"
+#include "record.hpp"
+#include "shared_spool.hpp"
+#include "shm_ring.hpp"
+#include "spool_chunk.hpp"
+#include "spool_map.hpp"
 
 using namespace simdjson;
 
@@ -18,10 +39,61 @@ struct Event {
     std::string json;
 };
 
+// Injector settings passed down through the environment.
+struct InjectorOptions {
+    std::string format = "json";
+    bool coalesce = false;
+    uint64_t flush_bytes = 1 << 20;
+    uint64_t buffer_cap = 64 << 20;
+    std::string drop_policy = "newest";
+    uint64_t ring_bytes = 0;
+    std::string clock = "realtime";
+    std::string spool = "mmap";
+    uint64_t shared_bytes = 1ull << 30;
+    std::string compress = "none";
+    std::vector<std::string> include;
+    std::vector<std::string> exclude;
+    std::vector<std::string> ops;
+    std::vector<std::string> sample;
+    std::vector<std::string> skip_fds;
+    bool stats = false;
+    bool hash = false;
+    bool latency = false;
+    bool summary = false;
+};
+
+static std::string join_items(const std::vector<std::string>& items,
+                              char separator) {
+    std::string joined;
+    for (const std::string& item : items) {
+        if (!joined.empty()) joined += separator;
+        joined += item;
+    }
+    return joined;
+}
+
 void set_env_variables(const std::string& path_exec,
-                       const std::string& path_access) {
+                       const std::string& path_access,
+                       const InjectorOptions& options) {
     setenv("PROV_PATH_EXEC", path_exec.c_str(), 1);
     setenv("PROV_PATH_WRITE", path_access.c_str(), 1);
+    setenv("PROV_FORMAT", options.format.c_str(), 1);
+    setenv("PROV_COALESCE", options.coalesce ? "1" : "0", 1);
+    setenv("PROV_FLUSH_BYTES", std::to_string(options.flush_bytes).c_str(), 1);
+    setenv("PROV_BUFFER_CAP", std::to_string(options.buffer_cap).c_str(), 1);
+    setenv("PROV_DROP_POLICY", options.drop_policy.c_str(), 1);
+    setenv("PROV_CLOCK", options.clock.c_str(), 1);
+    setenv("PROV_SPOOL", options.spool.c_str(), 1);
+    setenv("PROV_COMPRESS", options.compress.c_str(), 1);
+    setenv("PROV_PATH_INCLUDE", join_items(options.include, ':').c_str(), 1);
+    setenv("PROV_PATH_EXCLUDE", join_items(options.exclude, ':').c_str(), 1);
+    setenv("PROV_OPS", join_items(options.ops, ',').c_str(), 1);
+    setenv("PROV_SAMPLE", join_items(options.sample, ',').c_str(), 1);
+    setenv("PROV_STATS", options.stats ? "1" : "0", 1);
+    setenv("PROV_HASH", options.hash ? "1" : "0", 1);
+    setenv("PROV_LATENCY", options.latency ? "1" : "0", 1);
+    setenv("PROV_SUMMARY", options.summary ? "1" : "0", 1);
+    setenv("PROV_SKIP_FDS", join_items(options.skip_fds, ',').c_str(), 1);
 }
 
 void start_preload_process(const std::string& so_path, const std::string& cmd,
@@ -39,29 +111,682 @@ void start_preload_process(const std::string& so_path, const std::string& cmd,
     }
 }
 
-std::vector<Event> parse_injector_data(const std::string& path_access) {
-    std::vector<Event> events;
-    std::vector<std::string> filenames;
-    ondemand::parser parser;
-    for (const auto& entry : std::filesystem::directory_iterator(path_access)) {
-        std::ifstream injector_data_file(entry.path());
-        std::string json_object;
-        bool first = true;
-        uint64_t child_pid;
-        while (std::getline(injector_data_file, json_object)) {
-            ondemand::document doc = parser.iterate(json_object);
-            if (first) {
-                child_pid = doc["event_data"]["pid"].get_uint64().value();
-                first = false;
+using PathTable = std::unordered_map<uint32_t, std::string>;
+
+static std::string record_data_json(const RecordHeader& header,
+                                    RecordReader& payload,
+                                    const PathTable& paths) {
+    auto path = [&]() {
+        auto it = paths.find(payload.u32());
+        return json_string(it != paths.end() ? it->second : "");
+    };
+    switch (static_cast<RecordLayout>(header.layout)) {
+        case RecordLayout::PathIn:
+            return R"({"path_in":)" + path() + "}";
+        case RecordLayout::PathOut:
+            return R"({"path_out":)" + path() + "}";
+        case RecordLayout::PathInOut: {
+            std::string path_in = path();
+            return R"({"path_in":)" + path_in + R"(,"path_out":)" + path()
+                   + "}";
+        }
+        case RecordLayout::Path:
+            return R"({"path":)" + path() + "}";
+        case RecordLayout::PathError: {
+            std::string target = path();
+            int64_t err = static_cast<int64_t>(payload.u64());
+            return R"({"path":)" + target + R"(,"error":)"
+                   + std::to_string(err) + "}";
+        }
+        case RecordLayout::ChildPid:
+            return R"({"child_pid":)" + std::to_string(payload.u64()) + "}";
+        case RecordLayout::ChildPidPath: {
+            uint64_t child_pid = payload.u64();
+            return R"({"child_pid":)" + std::to_string(child_pid)
+                   + R"(,"path":)" + path() + "}";
+        }
+        case RecordLayout::Net: {
+            uint64_t fd = payload.u64();
+            uint64_t count = payload.u64();
+            std::string_view addr = payload.str();
+            std::string json = R"({"fd":)"
+                               + std::to_string(static_cast<int64_t>(fd))
+                               + R"(,"count":)" + std::to_string(count);
+            if (!addr.empty()) {
+                json += R"(,"sockaddr":")";
+                append_hex(json, addr);
+                json += '"';
+            }
+            return json + "}";
+        }
+        case RecordLayout::ProcessStart:
+            return R"({"pid":)" + std::to_string(header.pid) + R"(,"ppid":)"
+                   + std::to_string(payload.u64()) + "}";
+        case RecordLayout::PathInRun:
+        case RecordLayout::PathOutRun: {
+            bool output = header.layout
+                          == static_cast<uint8_t>(RecordLayout::PathOutRun);
+            std::string target = path();
+            uint64_t count = payload.u64();
+            uint64_t bytes = payload.u64();
+            uint64_t ts_end = payload.u64();
+            return (output ? R"({"path_out":)" : R"({"path_in":)") + target
+                   + R"(,"count":)" + std::to_string(count) + R"(,"bytes":)"
+                   + std::to_string(bytes) + R"(,"ts_end":)"
+                   + std::to_string(ts_end) + "}";
+        }
+        case RecordLayout::PathInBytes:
+        case RecordLayout::PathOutBytes: {
+            bool output = header.layout
+                          == static_cast<uint8_t>(RecordLayout::PathOutBytes);
+            std::string target = path();
+            return (output ? R"({"path_out":)" : R"({"path_in":)") + target
+                   + R"(,"bytes":)" + std::to_string(payload.u64()) + "}";
+        }
+        case RecordLayout::PathInOutBytes: {
+            std::string path_in = path();
+            std::string path_out = path();
+            return R"({"path_in":)" + path_in + R"(,"path_out":)" + path_out
+                   + R"(,"bytes":)" + std::to_string(payload.u64()) + "}";
+        }
+        case RecordLayout::ClockAnchor: {
+            auto source = static_cast<ClockSource>(payload.u64());
+            uint64_t wall_ns = payload.u64();
+            return R"({"clock":)" + json_string(clock_source_name(source))
+                   + R"(,"wall_ns":)" + std::to_string(wall_ns) + "}";
+        }
+        case RecordLayout::Dropped:
+            return R"({"events":)" + std::to_string(payload.u64()) + "}";
+        case RecordLayout::Overhead: {
+            uint64_t recorded = payload.u64();
+            uint64_t dropped = payload.u64();
+            uint64_t hooks = payload.u64();
+            std::string json = R"({"events":)" + std::to_string(recorded)
+                               + R"(,"dropped":)" + std::to_string(dropped)
+                               + R"(,"hooks":[)";
+            for (uint64_t i = 0; i < hooks; i++) {
+                uint64_t call = payload.u64();
+                uint64_t calls = payload.u64();
+                uint64_t log_ns = payload.u64();
+                if (call >= static_cast<uint64_t>(Call::Count)) continue;
+                if (json.back() == '}') json += ",";
+                json += R"({"call":)" + json_string(call_name(Call(call)))
+                        + R"(,"calls":)" + std::to_string(calls)
+                        + R"(,"log_ns":)" + std::to_string(log_ns) + "}";
+            }
+            return json + "]}";
+        }
+        case RecordLayout::FileDigest: {
+            std::string target = path();
+            uint64_t bytes = payload.u64();
+            bool hashed = payload.u64();
+            uint64_t high = payload.u64();
+            uint64_t low = payload.u64();
+            std::string json = R"({"path":)" + target + R"(,"bytes":)"
+                               + std::to_string(bytes);
+            if (!hashed) return json + R"(,"rehash":true})";
+            char hex[33];
+            std::snprintf(hex, sizeof(hex), "%016llx%016llx",
+                          static_cast<unsigned long long>(high),
+                          static_cast<unsigned long long>(low));
+            return json + R"(,"xxh3_128":")" + hex + R"("})";
+        }
+        case RecordLayout::Latency: {
+            std::string target = path();
+            uint64_t kind = payload.u64();
+            uint64_t calls = payload.u64();
+            uint64_t total_ns = payload.u64();
+            uint64_t buckets = payload.u64();
+            std::string json = R"({"path":)" + target + R"(,"io":)"
+                               + json_string(kind < io_kind_count
+                                                 ? io_kind_names[kind]
+                                                 : "unknown")
+                               + R"(,"calls":)" + std::to_string(calls)
+                               + R"(,"total_ns":)" + std::to_string(total_ns)
+                               + R"(,"histogram":[)";
+            for (uint64_t i = 0; i < buckets; i++) {
+                uint64_t bucket = payload.u64();
+                uint64_t count = payload.u64();
+                if (i) json += ",";
+                json += "[" + std::to_string(bucket) + ","
+                        + std::to_string(count) + "]";
             }
-            uint64_t new_ts = doc["event_header"]["ts"].get_uint64().value();
-            events.push_back({new_ts, child_pid, json_object});
+            return json + "]}";
+        }
+        case RecordLayout::Summary: {
+            uint64_t entries = payload.u64();
+            std::string json = R"({"paths":[)";
+            for (uint64_t i = 0; i < entries; i++) {
+                std::string target = path();
+                uint64_t op = payload.u64();
+                bool output = payload.u64();
+                uint64_t count = payload.u64();
+                uint64_t bytes = payload.u64();
+                uint64_t first_ts = payload.u64();
+                uint64_t last_ts = payload.u64();
+                if (i) json += ",";
+                json += R"({"op":)"
+                        + json_string(op < sysop_count ? sysop_names[op]
+                                                       : "unknown")
+                        + (output ? R"(,"path_out":)" : R"(,"path_in":)")
+                        + target + R"(,"count":)" + std::to_string(count)
+                        + R"(,"bytes":)" + std::to_string(bytes)
+                        + R"(,"first_ts":)" + std::to_string(first_ts)
+                        + R"(,"last_ts":)" + std::to_string(last_ts) + "}";
+            }
+            return json + "]}";
+        }
+        case RecordLayout::Empty:
+        default:
+            return "{}";
+    }
+}
+
+static void parse_records(const char* pos, const char* end, PathTable& paths,
+                          std::vector<Event>& events) {
+    RecordHeader header;
+    RecordReader payload(pos, pos);
+    while (next_record(pos, end, header, payload)) {
+        if (header.layout == static_cast<uint8_t>(RecordLayout::PathDef)) {
+            uint32_t id = payload.u32();
+            paths[id] = payload.str();
+            continue;
+        }
+        if (header.call >= static_cast<uint16_t>(Call::Count)) continue;
+        std::string json = R"({"event_header":{"operation":")"
+                           + std::string(call_name(Call{header.call}))
+                           + R"(","ts":)" + std::to_string(header.ts)
+                           + R"(,"tid":)" + std::to_string(header.tid)
+                           + R"(},"event_data":)"
+                           + record_data_json(header, payload, paths) + "}";
+        events.push_back({header.ts, header.pid, std::move(json)});
+    }
+}
+
+// Decodes compressed chunks one at a time, so only one is held uncompressed,
+// and hands each to `parse`. Stops at a truncated or corrupt chunk.
+template <class Parse>
+static void parse_chunks(const char* pos, const char* end, Parse parse) {
+    std::string raw;
+    while (next_chunk(pos, end, raw))
+        parse(raw.data(), raw.data() + raw.size());
+}
+
+// Data from an injector built with other record layouts would be misread, so
+// it is skipped with a warning.
+static bool known_record_version(const std::filesystem::path& path,
+                                 uint32_t version) {
+    if (version == record_version) return true;
+    std::cerr << "Warning: skipping " << path.string() << ": record version "
+              << version << ", prov reads version " << record_version
+              << std::endl;
+    return false;
+}
+
+static void parse_injector_records(const std::filesystem::path& path,
+                                   bool compressed,
+                                   std::vector<Event>& events) {
+    std::ifstream injector_data_file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(injector_data_file)),
+                     std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(RecordFileHeader)
+        || std::memcmp(data.data(), record_magic, sizeof(record_magic)) != 0)
+        return;
+    const RecordFileHeader* file_header
+        = reinterpret_cast<const RecordFileHeader*>(data.data());
+    if (!known_record_version(path, file_header->version)) return;
+    PathTable paths;
+    const char* begin = data.data() + sizeof(RecordFileHeader);
+    const char* end = data.data() + data.size();
+    if (!compressed) {
+        parse_records(begin, end, paths, events);
+        return;
+    }
+    parse_chunks(begin, end, [&](const char* pos, const char* chunk_end) {
+        parse_records(pos, chunk_end, paths, events);
+    });
+}
+
+static void parse_json_events(std::string_view data, uint64_t pid,
+                              ondemand::parser& parser,
+                              std::vector<Event>& events) {
+    while (!data.empty()) {
+        size_t line_end = data.find('\n');
+        std::string json_object(data.substr(0, line_end));
+        data.remove_prefix(line_end == std::string_view::npos ? data.size()
+                                                              : line_end + 1);
+        if (json_object.empty()) continue;
+        ondemand::document doc = parser.iterate(json_object);
+        uint64_t new_ts = doc["event_header"]["ts"].get_uint64().value();
+        events.push_back({new_ts, pid, std::move(json_object)});
+    }
+}
+
+// Reads the committed part of one thread's mapped spool file. Bytes past
+// `committed` belong to a record that was cut off and are ignored.
+static void parse_spool_file(const std::filesystem::path& path,
+                             ondemand::parser& parser,
+                             std::vector<Event>& events) {
+    std::ifstream spool_file(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(spool_file)),
+                     std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(SpoolHeader)
+        || std::memcmp(data.data(), spool_magic, sizeof(spool_magic)) != 0)
+        return;
+    const SpoolHeader* spool
+        = reinterpret_cast<const SpoolHeader*>(data.data());
+    if (!known_record_version(path, spool->version)) return;
+    uint64_t committed = spool->committed.load(std::memory_order_acquire);
+    committed = std::min<uint64_t>(committed,
+                                   data.size() - sizeof(SpoolHeader));
+    const char* begin = spool_data(spool);
+    PathTable paths;
+    auto parse = [&](const char* pos, const char* end) {
+        if (spool->binary)
+            parse_records(pos, end, paths, events);
+        else
+            parse_json_events(std::string_view(pos, end - pos), spool->pid,
+                              parser, events);
+    };
+    if (spool->compressed)
+        parse_chunks(begin, begin + committed, parse);
+    else
+        parse(begin, begin + committed);
+}
+
+// Creates the shared ring the injector streams into (prov exec --ring-bytes)
+// and maps it.
+static RingHeader* create_event_ring(const std::string& path,
+                                     uint64_t capacity) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return nullptr;
+    size_t size = ring_mapping_size(capacity);
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path.c_str());
+        return nullptr;
+    }
+    RingHeader* ring = new (map) RingHeader;
+    init_ring(ring, capacity, record_version);
+    return ring;
+}
+
+// Maps a control page at `path`, creating it with `word` when `create` is
+// set. The traced processes map it read-only; prov keeps it writable.
+static ControlPage* map_control_page(const std::string& path, bool create,
+                                     uint64_t word) {
+    int flags = create ? O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC
+                       : O_RDWR | O_CLOEXEC;
+    int fd = open(path.c_str(), flags, 0600);
+    if (fd < 0) return nullptr;
+    void* map = MAP_FAILED;
+    if (!create || ftruncate(fd, sizeof(ControlPage)) == 0)
+        map = mmap(nullptr, sizeof(ControlPage), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        if (create) unlink(path.c_str());
+        return nullptr;
+    }
+    ControlPage* page = static_cast<ControlPage*>(map);
+    if (create) {
+        init_control_page(page, word);
+    } else if (std::memcmp(page->magic, control_magic,
+                           sizeof(control_magic)) != 0) {
+        munmap(map, sizeof(ControlPage));
+        return nullptr;
+    }
+    return page;
+}
+
+// Control page of a running prov exec: that of `session` (its pid) if set,
+// otherwise the only one in /dev/shm.
+static std::string find_control_page(const std::string& session) {
+    if (!session.empty()) return "/dev/shm/prov_" + session + ".control";
+    std::vector<std::string> found;
+    std::error_code error;
+    for (const auto& entry :
+         std::filesystem::directory_iterator("/dev/shm", error)) {
+        std::string name = entry.path().filename();
+        if (name.rfind("prov_", 0) == 0
+            && entry.path().extension() == ".control")
+            found.push_back(entry.path());
+    }
+    return found.size() == 1 ? found.front() : "";
+}
+
+// Creates the spool every traced process appends to (prov exec --spool
+// shared) and maps it. The file is sparse; tmpfs only backs what is written.
+static SharedSpoolHeader* create_shared_spool(const std::string& path,
+                                              uint64_t capacity, bool binary,
+                                              bool compressed) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) return nullptr;
+    size_t size = shared_spool_size(capacity);
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path.c_str());
+        return nullptr;
+    }
+    SharedSpoolHeader* spool = new (map) SharedSpoolHeader;
+    init_shared_spool(spool, capacity, record_version, binary, compressed);
+    return spool;
+}
+
+// Decodes the whole shared spool in one pass. Path ids are per process, and
+// a process defines each path before the first chunk that uses it.
+static void parse_shared_spool(const SharedSpoolHeader* spool,
+                               std::vector<Event>& events) {
+    std::unordered_map<uint32_t, PathTable> paths;
+    ondemand::parser parser;
+    auto parse = [&](uint32_t pid, const char* pos, const char* end) {
+        if (spool->binary)
+            parse_records(pos, end, paths[pid], events);
+        else
+            parse_json_events(std::string_view(pos, end - pos), pid, parser,
+                              events);
+    };
+    shared_spool_read(spool, [&](uint32_t pid, const char* data, size_t size) {
+        if (!spool->compressed) {
+            parse(pid, data, data + size);
+            return;
+        }
+        parse_chunks(data, data + size, [&](const char* pos, const char* end) {
+            parse(pid, pos, end);
+        });
+    });
+}
+
+// The numbers a spool file name starts with: pid, tid and generation for
+// <pid>.<tid>.<generation>.spool, the pid alone for <pid>.jsonl and the like.
+static std::vector<uint64_t> spool_name_key(const std::filesystem::path& path) {
+    std::vector<uint64_t> key;
+    std::string name = path.filename().string();
+    const char* pos = name.c_str();
+    while (isdigit(static_cast<unsigned char>(*pos))) {
+        char* end;
+        key.push_back(std::strtoull(pos, &end, 10));
+        pos = *end == '.' ? end + 1 : end;
+    }
+    return key;
+}
+
+// The spool files of a run ordered by the numbers in their names. Events that
+// share a timestamp keep this order through the stable sort, so an image that
+// exec replaced comes ahead of its successor (a lower generation) and a main
+// thread ahead of the threads it started.
+static std::vector<std::filesystem::path> spool_files(
+    const std::string& path_access) {
+    std::vector<std::pair<std::vector<uint64_t>, std::filesystem::path>> files;
+    for (const auto& entry : std::filesystem::directory_iterator(path_access))
+        files.emplace_back(spool_name_key(entry.path()), entry.path());
+    std::sort(files.begin(), files.end());
+    std::vector<std::filesystem::path> paths;
+    for (auto& file : files) paths.push_back(std::move(file.second));
+    return paths;
+}
+
+// Reads the integer after `key` in `json`, if it is there.
+static bool find_uint_field(const std::string& json, std::string_view key,
+                            uint64_t& value) {
+    size_t start = json.find(key);
+    if (start == std::string::npos) return false;
+    start += key.size();
+    if (!isdigit(static_cast<unsigned char>(json[start]))) return false;
+    value = std::strtoull(json.c_str() + start, nullptr, 10);
+    return true;
+}
+
+// Moves the events of a process that sorted ahead of the fork, vfork or spawn
+// that created it to just after that event. The child runs before the parent
+// logs the fork's return, and a coarse clock often gives both the same tick,
+// so timestamps alone can put a child ahead of its cause.
+static void order_children_after_parents(std::vector<Event>& events) {
+    std::unordered_map<uint64_t, size_t> cause;
+    for (size_t i = 0; i < events.size(); i++) {
+        uint64_t child;
+        if (find_uint_field(events[i].json, R"("child_pid":)", child))
+            cause.try_emplace(child, i);
+    }
+    if (cause.empty()) return;
+    std::unordered_map<size_t, uint64_t> caused;
+    for (const auto& [child, index] : cause) caused[index] = child;
+
+    std::vector<Event> ordered;
+    ordered.reserve(events.size());
+    std::vector<bool> emitted(events.size());
+    std::unordered_map<uint64_t, std::vector<size_t>> waiting;
+    // Emits an event, then whatever was waiting on it, depth first so a
+    // grandchild follows the event of its child that created it.
+    auto emit = [&](size_t first) {
+        std::vector<size_t> stack{first};
+        while (!stack.empty()) {
+            size_t i = stack.back();
+            stack.pop_back();
+            ordered.push_back(std::move(events[i]));
+            emitted[i] = true;
+            auto child = caused.find(i);
+            if (child == caused.end()) continue;
+            auto queued = waiting.find(child->second);
+            if (queued == waiting.end()) continue;
+            stack.insert(stack.end(), queued->second.rbegin(),
+                         queued->second.rend());
+            waiting.erase(queued);
+        }
+    };
+    for (size_t i = 0; i < events.size(); i++) {
+        auto parent = cause.find(events[i].pid);
+        if (parent != cause.end() && !emitted[parent->second])
+            waiting[events[i].pid].push_back(i);
+        else
+            emit(i);
+    }
+    // A reused pid can leave a cycle; keep those events in clock order.
+    std::vector<size_t> rest;
+    for (const auto& [pid, queued] : waiting)
+        rest.insert(rest.end(), queued.begin(), queued.end());
+    std::sort(rest.begin(), rest.end());
+    for (size_t i : rest)
+        if (!emitted[i]) emit(i);
+    events = std::move(ordered);
+}
+
+// Stable, so that events of one thread sharing a coarse timestamp keep
+// their order.
+static void sort_events(std::vector<Event>& events) {
+    std::stable_sort(
+        events.begin(), events.end(),
+        [](const Event& a, const Event& b) { return a.ts < b.ts; });
+    order_children_after_parents(events);
+}
+
+void parse_injector_data(const std::string& path_access,
+                         std::vector<Event>& events) {
+    ondemand::parser parser;
+    for (const std::filesystem::path& path : spool_files(path_access)) {
+        if (path.extension() == ".spool") {
+            parse_spool_file(path, parser, events);
+            continue;
+        }
+        // <pid>.bin or <pid>.jsonl, with .lz4 appended when compressed.
+        bool compressed = path.extension() == ".lz4";
+        std::filesystem::path name = path.filename();
+        if (compressed) name = name.stem();
+        if (name.extension() == ".bin") {
+            parse_injector_records(path, compressed, events);
+            continue;
         }
+        // Threads stream their events into the file in chunks, so the first
+        // line is not necessarily START_PROCESS; the file is named by pid.
+        uint64_t child_pid = std::stoull(name.stem().string());
+        std::ifstream injector_data_file(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(injector_data_file)),
+                         std::istreambuf_iterator<char>());
+        if (!compressed) {
+            parse_json_events(data, child_pid, parser, events);
+            continue;
+        }
+        parse_chunks(data.data(), data.data() + data.size(),
+                     [&](const char* pos, const char* end) {
+                         parse_json_events(std::string_view(pos, end - pos),
+                                           child_pid, parser, events);
+                     });
     }
     std::filesystem::remove_all(path_access);
-    std::sort(events.begin(), events.end(),
-              [](const Event& a, const Event& b) { return a.ts < b.ts; });
-    return events;
+    sort_events(events);
+}
+
+// Readings of the event clock and of wall and monotonic time taken together
+// by prov before and after the traced command.
+struct ClockAnchor {
+    uint64_t raw;
+    uint64_t wall_ns;
+    uint64_t mono_ns;
+};
+
+static ClockAnchor take_clock_anchor(ClockSource source) {
+    return {read_clock(source), read_clock_id(CLOCK_REALTIME),
+            read_clock_id(CLOCK_MONOTONIC)};
+}
+
+// Replaces the integer after `key` (searched from `from`) with convert(value)
+// and returns where the search can resume, or npos once `key` is not found.
+template <class Convert>
+static size_t rewrite_uint_field(std::string& json, std::string_view key,
+                                 size_t from, Convert convert) {
+    size_t start = json.find(key, from);
+    if (start == std::string::npos) return start;
+    start += key.size();
+    size_t end = start;
+    while (end < json.size() && isdigit(static_cast<unsigned char>(json[end])))
+        end++;
+    if (end == start) return end;
+    uint64_t value = std::stoull(json.substr(start, end - start));
+    std::string converted = std::to_string(convert(value));
+    json.replace(start, end - start, converted);
+    return start + converted.size();
+}
+
+// Converts raw event timestamps to wall-clock ns. Every process on the node
+// shares the clock, so a single increasing mapping for the whole run keeps
+// their order. It interpolates between prov's anchors and the CLOCK_ANCHOR
+// each process records at startup; outside them, TSC ticks are scaled by the
+// monotonic time the run took.
+static void convert_event_times(std::vector<Event>& events,
+                                ClockSource source, const ClockAnchor& start,
+                                const ClockAnchor& end) {
+    if (source == ClockSource::Realtime) return;
+    double ns_per_tick = 1.0;
+    if (source == ClockSource::Tsc && end.raw > start.raw)
+        ns_per_tick = static_cast<double>(end.mono_ns - start.mono_ns)
+                      / static_cast<double>(end.raw - start.raw);
+
+    std::vector<std::pair<uint64_t, uint64_t>> anchors = {
+        {start.raw, start.wall_ns}, {end.raw, end.wall_ns}};
+    std::string clock = R"("clock":")" + std::string(clock_source_name(source))
+                        + "\"";
+    for (const Event& event : events) {
+        uint64_t wall_ns;
+        if (event.json.find(R"("operation":"CLOCK_ANCHOR")") != std::string::npos
+            && event.json.find(clock) != std::string::npos
+            && find_uint_field(event.json, R"("wall_ns":)", wall_ns))
+            anchors.emplace_back(event.ts, wall_ns);
+    }
+    // Of the anchors that read one tick, the earliest wall time is closest to
+    // where the tick began; wall time is kept from going backwards so that
+    // the mapping never reorders events.
+    std::sort(anchors.begin(), anchors.end());
+    anchors.erase(std::unique(anchors.begin(), anchors.end(),
+                              [](const auto& a, const auto& b) {
+                                  return a.first == b.first;
+                              }),
+                  anchors.end());
+    for (size_t i = 1; i < anchors.size(); i++)
+        anchors[i].second = std::max(anchors[i].second, anchors[i - 1].second);
+
+    auto scaled = [&](uint64_t ticks) {
+        return static_cast<uint64_t>(static_cast<double>(ticks) * ns_per_tick);
+    };
+    auto to_wall_ns = [&](uint64_t raw) -> uint64_t {
+        const auto& [first_raw, first_wall] = anchors.front();
+        const auto& [last_raw, last_wall] = anchors.back();
+        if (raw <= first_raw) return first_wall - scaled(first_raw - raw);
+        if (raw >= last_raw) return last_wall + scaled(raw - last_raw);
+        auto next = std::upper_bound(
+            anchors.begin(), anchors.end(), raw,
+            [](uint64_t value, const auto& anchor) {
+                return value < anchor.first;
+            });
+        auto prev = next - 1;
+        double fraction = static_cast<double>(raw - prev->first)
+                          / static_cast<double>(next->first - prev->first);
+        return prev->second
+               + static_cast<uint64_t>(
+                   fraction * static_cast<double>(next->second - prev->second));
+    };
+    for (Event& event : events) {
+        event.ts = to_wall_ns(event.ts);
+        size_t header = event.json.find(R"("event_header":{)");
+        rewrite_uint_field(event.json, R"("ts":)", header, to_wall_ns);
+        rewrite_uint_field(event.json, R"("ts_end":)", header, to_wall_ns);
+        // Summaries carry a pair of times per path.
+        for (std::string_view key : {R"("first_ts":)", R"("last_ts":)"})
+            for (size_t from = header; from != std::string::npos;)
+                from = rewrite_uint_field(event.json, key, from, to_wall_ns);
+    }
+}
+
+// Sums the OVERHEAD summaries of every traced process and prints which hooks
+// cost the most logging time.
+static void print_overhead_report(const std::vector<Event>& events) {
+    struct HookTotal {
+        uint64_t calls = 0;
+        uint64_t log_ns = 0;
+    };
+    std::unordered_map<std::string, HookTotal> hooks;
+    uint64_t processes = 0, recorded = 0, dropped = 0, log_ns = 0;
+    ondemand::parser parser;
+    for (const Event& event : events) {
+        if (event.json.find(R"("operation":"OVERHEAD")") == std::string::npos)
+            continue;
+        padded_string json(event.json);
+        ondemand::document doc = parser.iterate(json);
+        ondemand::object data = doc["event_data"].get_object().value();
+        processes++;
+        recorded += data["events"].get_uint64().value();
+        dropped += data["dropped"].get_uint64().value();
+        for (ondemand::value hook_value : data["hooks"].get_array()) {
+            ondemand::object hook = hook_value.get_object().value();
+            std::string call(hook["call"].get_string().value());
+            HookTotal& total = hooks[call];
+            uint64_t calls = hook["calls"].get_uint64().value();
+            uint64_t ns = hook["log_ns"].get_uint64().value();
+            total.calls += calls;
+            total.log_ns += ns;
+            log_ns += ns;
+        }
+    }
+    std::vector<std::pair<std::string, HookTotal>> ranked(hooks.begin(),
+                                                          hooks.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second.log_ns > b.second.log_ns;
+    });
+    std::fprintf(stderr,
+                 "prov: %" PRIu64 " processes, %" PRIu64 " events, %" PRIu64
+                 " dropped, %.3f ms logging\n",
+                 processes, recorded, dropped, log_ns / 1e6);
+    std::fprintf(stderr, "  %-20s %12s %12s %10s\n", "hook", "calls",
+                 "log ms", "ns/call");
+    for (const auto& [call, total] : ranked)
+        std::fprintf(stderr, "  %-20s %12" PRIu64 " %12.3f %10.0f\n",
+                     call.c_str(), total.calls, total.log_ns / 1e6,
+                     static_cast<double>(total.log_ns) / total.calls);
 }
 
 void send_json(const std::string& url, const std::string& json) {
@@ -89,27 +814,23 @@ std::string build_start_json_output(const std::string& path_start,
                                     const std::string& slurm_cluster_name,
                                     const std::string& json_start_extra) {
     std::string absolute_path_start = std::filesystem::canonical(path_start);
-    return R"({"header":{"type":"start","slurm_job_id":")" + slurm_job_id
-           + R"(","slurm_cluster_name":")" + slurm_cluster_name
-           + R"("},"payload":{"json":)" + json_start_extra + R"(,"path":")"
-           + absolute_path_start + R"("}})";
+    return R"({"header":{"type":"start","slurm_job_id":)"
+           + json_string(slurm_job_id) + R"(,"slurm_cluster_name":)"
+           + json_string(slurm_cluster_name) + R"(},"payload":{"json":)"
+           + json_start_extra + R"(,"path":)"
+           + json_string(absolute_path_start) + "}}";
 }
 
 std::string build_end_json_output(const std::string& slurm_job_id,
                                   const std::string& slurm_cluster_name,
                                   const std::string& json_end_extra) {
-    return R"({"header":{"type":"end","slurm_job_id":")" + slurm_job_id
-           + R"(","slurm_cluster_name":")" + slurm_cluster_name
-           + R"("},"payload":{"json":)" + json_end_extra + "}}";
+    return R"({"header":{"type":"end","slurm_job_id":)"
+           + json_string(slurm_job_id) + R"(,"slurm_cluster_name":)"
+           + json_string(slurm_cluster_name) + R"(},"payload":{"json":)"
+           + json_end_extra + "}}";
 }
 
-std::string build_exec_json_output(const std::string& slurm_job_id,
-                                   const std::string& slurm_cluster_name,
-                                   const std::string& path_exec,
-                                   const std::string& json_exec,
-                                   const std::string& cmd,
-                                   const std::vector<Event>& events) {
-    std::string json_object;
+static std::string build_event_array(const std::vector<Event>& events) {
     std::ostringstream event_array;
     event_array << "[";
     bool first = true;
@@ -124,14 +845,102 @@ std::string build_exec_json_output(const std::string& slurm_job_id,
         first = false;
     }
     event_array << "]";
-    std::string absolute_path_exec = std::filesystem::canonical(path_exec);
-    std::string json_string = R"({"header":{"type":"exec","slurm_job_id":")"
-                              + slurm_job_id + R"(","slurm_cluster_name":")"
-                              + slurm_cluster_name
-                              + R"("},"payload":{"events":)" + event_array.str()
-                              + R"(,"json":)" + json_exec + R"(,"path":")"
-                              + path_exec + R"(","command":")" + cmd + R"("}})";
-    return json_string;
+    return event_array.str();
+}
+
+// The exec request holds the events not yet sent in exec_batch requests of
+// the same session.
+std::string build_exec_json_output(const std::string& slurm_job_id,
+                                   const std::string& slurm_cluster_name,
+                                   const std::string& session,
+                                   const std::string& path_exec,
+                                   const std::string& json_exec,
+                                   const std::string& cmd,
+                                   const std::vector<Event>& events) {
+    return R"({"header":{"type":"exec","slurm_job_id":)"
+           + json_string(slurm_job_id) + R"(,"slurm_cluster_name":)"
+           + json_string(slurm_cluster_name) + R"(,"session":)"
+           + json_string(session) + R"(},"payload":{"events":)"
+           + build_event_array(events) + R"(,"json":)" + json_exec
+           + R"(,"path":)" + json_string(path_exec) + R"(,"command":)"
+           + json_string(cmd) + "}}";
+}
+
+std::string build_exec_batch_json_output(const std::string& slurm_job_id,
+                                         const std::string& slurm_cluster_name,
+                                         const std::string& session,
+                                         const std::vector<Event>& events) {
+    return R"({"header":{"type":"exec_batch","slurm_job_id":)"
+           + json_string(slurm_job_id) + R"(,"slurm_cluster_name":)"
+           + json_string(slurm_cluster_name) + R"(,"session":)"
+           + json_string(session) + R"(},"payload":{"events":)"
+           + build_event_array(events) + "}}";
+}
+
+// Where prov exec sends the events of the traced command. `session`, prov's
+// pid, ties the batches sent while the command runs to its exec request.
+struct ExecUpload {
+    std::string url;
+    std::string slurm_job_id;
+    std::string slurm_cluster_name;
+    std::string session;
+    ClockSource clock_source;
+    ClockAnchor clock_start;
+};
+
+// Ring events go out once this many are decoded, or a second after the last
+// batch, whichever comes first.
+static constexpr size_t batch_events = 50000;
+static constexpr auto batch_interval = std::chrono::seconds(1);
+
+// Sends `events` as one exec_batch request, ordered and with their times
+// converted by the clock readings taken so far, and empties it. OVERHEAD
+// events are kept in `sent_overhead` for the --stats report.
+static void send_event_batch(const ExecUpload& upload,
+                             std::vector<Event>& events,
+                             std::vector<Event>& sent_overhead) {
+    sort_events(events);
+    convert_event_times(events, upload.clock_source, upload.clock_start,
+                        take_clock_anchor(upload.clock_source));
+    for (const Event& event : events)
+        if (event.json.find(R"("operation":"OVERHEAD")") != std::string::npos)
+            sent_overhead.push_back(event);
+    send_json(upload.url, build_exec_batch_json_output(
+                              upload.slurm_job_id, upload.slurm_cluster_name,
+                              upload.session, events));
+    events.clear();
+}
+
+// Decodes ring chunks and sends them on in batches until `command_done` is
+// set, then drains what is left into `events`. Only that tail goes into the
+// exec request sent after the command exits, so the upload at the end of a
+// step stays small however many events the command recorded.
+static void consume_event_ring(RingHeader* ring, bool binary,
+                               const std::atomic<bool>& command_done,
+                               const ExecUpload& upload,
+                               std::vector<Event>& events,
+                               std::vector<Event>& sent_overhead) {
+    std::unordered_map<uint32_t, PathTable> paths;
+    ondemand::parser parser;
+    auto consume = [&](uint32_t pid, const char* data, size_t size) {
+        if (binary)
+            parse_records(data, data + size, paths[pid], events);
+        else
+            parse_json_events(std::string_view(data, size), pid, parser,
+                              events);
+    };
+    auto last_batch = std::chrono::steady_clock::now();
+    while (!command_done.load()) {
+        bool drained = ring_drain(ring, consume);
+        auto now = std::chrono::steady_clock::now();
+        if (events.size() >= batch_events
+            || (!events.empty() && now - last_batch >= batch_interval)) {
+            send_event_batch(upload, events, sent_overhead);
+            last_batch = now;
+        }
+        if (!drained) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ring_drain(ring, consume);
 }
 
 int main(int argc, char** argv) {
@@ -161,6 +970,95 @@ int main(int argc, char** argv) {
     exec->add_option("--path", path_exec, "Spefify path")->required();
     exec->add_option("--json", json_exec_extra,
                      "Provide optional extra metadata");
+    InjectorOptions injector_options;
+    exec->add_option("--format", injector_options.format,
+                     "Injector spool format (json or binary)")
+        ->check(CLI::IsMember({"json", "binary"}));
+    exec->add_flag("--coalesce", injector_options.coalesce,
+                   "Fold repeated reads/writes on one fd into counted events");
+    exec->add_option("--flush-bytes", injector_options.flush_bytes,
+                     "Per-thread buffer size that triggers a spool write "
+                     "(0 buffers until exit)");
+    exec->add_option("--buffer-cap", injector_options.buffer_cap,
+                     "Per-thread buffer limit before events are dropped "
+                     "(0 for no limit)");
+    exec->add_option("--drop-policy", injector_options.drop_policy,
+                     "Events to drop at the buffer cap (newest or oldest)")
+        ->check(CLI::IsMember({"newest", "oldest"}));
+    exec->add_option("--clock", injector_options.clock,
+                     "Event timestamp source (realtime, monotonic, coarse "
+                     "or tsc)")
+        ->check(CLI::IsMember({"realtime", "monotonic", "coarse", "tsc"}));
+    exec->add_option("--spool", injector_options.spool,
+                     "How threads persist events: mmap commits each event to "
+                     "a mapped file that survives exec and kills, stream "
+                     "appends chunks to one file per process, shared commits "
+                     "each event to one mapped file for every process")
+        ->check(CLI::IsMember({"mmap", "stream", "shared"}));
+    exec->add_option("--shared-bytes", injector_options.shared_bytes,
+                     "Size of the shared spool (--spool shared); processes "
+                     "fall back to their own spool file once it is full");
+    exec->add_option("--compress", injector_options.compress,
+                     "Compress spool files (none or lz4); events are then "
+                     "written out a flush threshold at a time and at exec "
+                     "and exit, so a killed process loses the events it had "
+                     "not written out")
+        ->check(CLI::IsMember({"none", "lz4"}));
+    exec->add_option("--ring-bytes", injector_options.ring_bytes,
+                     "Stream events through a shared-memory ring of this "
+                     "size and send them to the receiver in batches while "
+                     "the command runs, rather than from spool files in one "
+                     "request afterwards (0 for spool files only). Threads "
+                     "hand events over a flush threshold at a time "
+                     "and at exec and exit, so a killed process loses what "
+                     "it had not handed over");
+    exec->add_option("--include", injector_options.include,
+                     "Only record paths under this prefix (repeatable, "
+                     "default --path)");
+    exec->add_option("--exclude", injector_options.exclude,
+                     "Do not record paths under this prefix (repeatable)");
+    exec->add_option("--ops", injector_options.ops,
+                     "Only record these op classes, e.g. exec,spawn,write "
+                     "(repeatable, default all)");
+    exec->add_option("--sample", injector_options.sample,
+                     "Thin an op class as class:first:every, keeping the "
+                     "first events then one in every (repeatable)");
+    auto control = app.add_subcommand(
+        "control", "Switch tracing of a running exec on or off");
+    std::string control_state;
+    std::string control_session;
+    std::vector<std::string> control_ops;
+    control->add_option("state", control_state, "on or off")
+        ->required()
+        ->check(CLI::IsMember({"on", "off"}));
+    control->add_option("--session", control_session,
+                        "pid of the prov exec to control (default: the only "
+                        "one running)");
+    control->add_option("--ops", control_ops,
+                        "Record only these op classes from now on "
+                        "(repeatable, default all)");
+    exec->add_option("--skip-fds", injector_options.skip_fds,
+                     "Do not record I/O on these descriptor kinds: pipe, "
+                     "socket, char, anon or none (repeatable, default all "
+                     "four)")
+        ->check(CLI::IsMember({"pipe", "socket", "char", "anon", "none"}));
+    exec->add_flag("--stats", injector_options.stats,
+                   "Report per-hook call counts and logging time after the "
+                   "command");
+    exec->add_flag("--hash", injector_options.hash,
+                   "Hash files as the command writes them and record an "
+                   "XXH3-128 digest, or that a file needs hashing after the "
+                   "fact, when each is closed");
+    exec->add_flag("--latency", injector_options.latency,
+                   "Profile the latency of reads, writes and syncs per path, "
+                   "recorded as log2-ns histograms once per process");
+    exec->add_flag("--summary", injector_options.summary,
+                   "Record opens, reads, writes and transfers as one summary "
+                   "per process, with counts, bytes and first and last times "
+                   "per path, instead of an event per call");
+    bool paused = false;
+    exec->add_flag("--paused", paused,
+                   "Start with tracing off until prov control on");
     app.require_subcommand();
     CLI11_PARSE(app, argc, argv);
 
@@ -186,16 +1084,93 @@ int main(int argc, char** argv) {
         std::string end_json_output = build_end_json_output(
             slurm_job_id, slurm_cluster_name, json_end_extra);
         send_json(endpoint_url, end_json_output);
+    } else if (*control) {
+        std::string control_path = find_control_page(control_session);
+        ControlPage* page = control_path.empty()
+                                ? nullptr
+                                : map_control_page(control_path, false, 0);
+        if (!page) {
+            std::cerr << "No prov exec to control"
+                      << (control_session.empty() ? ""
+                                                  : " with that session")
+                      << "\n";
+            return 1;
+        }
+        uint64_t mask = sysop_mask(join_items(control_ops, ','));
+        page->word.store((control_state == "on" ? control_enabled : 0) | mask,
+                         std::memory_order_relaxed);
+        munmap(page, sizeof(ControlPage));
     } else if (*exec) {
         std::string absolute_path_exec = std::filesystem::canonical(path_exec);
         std::string path_access = "/dev/shm/prov_" + std::to_string(getpid());
-        set_env_variables(absolute_path_exec, path_access);
+        set_env_variables(absolute_path_exec, path_access, injector_options);
+        std::string control_path = path_access + ".control";
+        uint64_t control_word =
+            (paused ? 0 : control_enabled)
+            | sysop_mask(join_items(injector_options.ops, ','));
+        ControlPage* control_page =
+            map_control_page(control_path, true, control_word);
+        if (control_page) setenv("PROV_CONTROL", control_path.c_str(), 1);
+        std::vector<Event> events;
+        std::vector<Event> sent_overhead;
+        ClockSource clock_source = clock_source_from(injector_options.clock);
+        ClockAnchor clock_start = take_clock_anchor(clock_source);
+        ExecUpload upload{.url = endpoint_url,
+                          .slurm_job_id = slurm_job_id,
+                          .slurm_cluster_name = slurm_cluster_name,
+                          .session = std::to_string(getpid()),
+                          .clock_source = clock_source,
+                          .clock_start = clock_start};
+        std::string ring_path = path_access + ".ring";
+        RingHeader* ring = nullptr;
+        if (injector_options.ring_bytes)
+            ring = create_event_ring(ring_path, injector_options.ring_bytes);
+        std::atomic<bool> command_done{false};
+        std::thread ring_consumer;
+        if (ring) {
+            setenv("PROV_RING", ring_path.c_str(), 1);
+            ring_consumer = std::thread(
+                consume_event_ring, ring, injector_options.format == "binary",
+                std::cref(command_done), std::cref(upload), std::ref(events),
+                std::ref(sent_overhead));
+        }
+        std::string shared_path = path_access + ".spool";
+        SharedSpoolHeader* shared_spool = nullptr;
+        if (injector_options.spool == "shared")
+            shared_spool = create_shared_spool(
+                shared_path, injector_options.shared_bytes,
+                injector_options.format == "binary",
+                injector_options.compress == "lz4");
+        if (shared_spool) setenv("PROV_SHARED_SPOOL", shared_path.c_str(), 1);
         std::string injector_path = "./injector/build/libinjector.so";
         start_preload_process(injector_path, command, path_access);
-        std::vector<Event> events = parse_injector_data(path_access);
+        ClockAnchor clock_end = take_clock_anchor(clock_source);
+        if (ring) {
+            command_done = true;
+            ring_consumer.join();
+            munmap(ring, ring_mapping_size(injector_options.ring_bytes));
+            unlink(ring_path.c_str());
+        }
+        if (control_page) {
+            munmap(control_page, sizeof(ControlPage));
+            unlink(control_path.c_str());
+        }
+        if (shared_spool) {
+            parse_shared_spool(shared_spool, events);
+            munmap(shared_spool,
+                   shared_spool_size(injector_options.shared_bytes));
+            unlink(shared_path.c_str());
+        }
+        parse_injector_data(path_access, events);
+        convert_event_times(events, clock_source, clock_start, clock_end);
+        if (injector_options.stats) {
+            sent_overhead.insert(sent_overhead.end(), events.begin(),
+                                 events.end());
+            print_overhead_report(sent_overhead);
+        }
         std::string exec_json_output = build_exec_json_output(
-            slurm_job_id, slurm_cluster_name, absolute_path_exec,
-            json_exec_extra, command, events);
+            slurm_job_id, slurm_cluster_name, upload.session,
+            absolute_path_exec, json_exec_extra, command, events);
         send_json(endpoint_url, exec_json_output);
     }
 }
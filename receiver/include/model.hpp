@@ -1,46 +1,15 @@
 #pragma once
 #include <cstdint>
+#include <map>
 #include <mutex>
 #include <queue>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <variant>
+#include <vector>
 
-enum class SysOp {
-    Write,
-    Writev,
-    Pwrite,
-    Pwritev,
-    Truncate,
-    Msync,
-    Fallocate,
-    Read,
-    Readv,
-    Pread,
-    Preadv,
-    Getdents,
-    Transfer,
-    Open,
-    Close,
-    Dup,
-    Pipe,
-    Rename,
-    Link,
-    SymLink,
-    Unlink,
-    NetSend,
-    NetRecv,
-    Exec,
-    Spawn,
-    Fork,
-    System,
-    ProcessStart,
-    ProcessEnd,
-    JobStart,
-    JobEnd,
-    Unknown
-};
+#include "sysop.hpp"
 
 struct EventHeader {
     uint64_t ts = 0;
@@ -51,14 +20,17 @@ struct EventHeader {
 struct AccessIn {
     std::string path_in;
     uint32_t count = 0;
+    uint64_t bytes = 0;
 };
 struct AccessOut {
     std::string path_out;
     uint32_t count = 0;
+    uint64_t bytes = 0;
 };
 struct AccessInOut {
     std::string path_in;
     std::string path_out;
+    uint64_t bytes = 0;  // transfers only
 };
 
 struct ExecCall {
@@ -75,6 +47,11 @@ struct SpawnCall {
 struct ForkCall {
     uint64_t child_pid = -1;
 };
+struct NetCall {
+    int64_t fd = -1;
+    uint32_t count = 0;
+    std::string addr;  // formatted peer address, empty if not given
+};
 
 struct ProcessStart {
     uint64_t ppid = 0;
@@ -83,18 +60,72 @@ struct ProcessStart {
 };
 struct ProcessEnd {};
 
+struct HookOverhead {
+    uint64_t calls = 0;
+    uint64_t log_ns = 0;
+};
+// What tracing cost one process (an OVERHEAD event), or an exec step summed
+// over its processes. Hooks are keyed by call name.
+struct Overhead {
+    uint64_t processes = 0;
+    uint64_t events = 0;
+    uint64_t dropped = 0;
+    std::unordered_map<std::string, HookOverhead> hooks;
+};
+
+// Content of a file a process wrote, taken when its last fd closed
+// (a FILE_DIGEST event).
+struct FileDigest {
+    std::string path;
+    uint64_t bytes = 0;
+    std::string xxh3_128;  // hex, empty if the file needs hashing afterwards
+};
+
+// Latencies of the real calls of one kind of I/O on a path, from a LATENCY
+// event or merged over an exec step. Bucket b counts calls that took
+// [2^b, 2^(b+1)) ns.
+struct LatencyHistogram {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    std::map<uint32_t, uint64_t> buckets;
+};
+struct PathLatency {
+    std::string path;
+    std::string io;  // read, write or sync
+    LatencyHistogram histogram;
+};
+
+// What a process did to one path in one class of operation, in place of the
+// individual events (a SUMMARY event holds one per path and class).
+struct SummaryEntry {
+    SysOp op = SysOp::Unknown;
+    std::string path;
+    bool output = false;  // written to, rather than read from
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t first_ts = 0;
+    uint64_t last_ts = 0;
+};
+struct ProcessSummary {
+    std::vector<SummaryEntry> entries;
+};
+
 using EventPayload
     = std::variant<AccessIn, AccessOut, AccessInOut, ExecCall, SpawnCall,
-                   ForkCall, ProcessStart, ProcessEnd>;
+                   ForkCall, NetCall, ProcessStart, ProcessEnd, Overhead,
+                   FileDigest, PathLatency, ProcessSummary>;
 
 struct Event {
     uint64_t ts = 0;
     SysOp operation = SysOp::Unknown;
     uint64_t pid = 0;
+    uint64_t tid = 0;
     EventPayload event_payload;
 };
 
-enum class CallType { Start, End, Exec };
+// An exec step's events come in one exec request, which closes the step, or
+// first in exec_batch requests of the same session while the command runs.
+enum class CallType { Start, End, Exec, ExecBatch };
 
 struct StartOrEnd {
     uint64_t ts = 0;
@@ -112,6 +143,7 @@ struct ParsedRequest {
     CallType type;
     std::string job_id;
     std::string cluster_name;
+    std::string session;  // the prov exec that sent an exec or exec_batch
     std::string path;
     RequestPayload request_payload;
 };
@@ -146,6 +178,16 @@ struct ProcessProvExec {
     std::string target_path;
     // bool failed = false;
 };
+struct ProcessProvNet {
+    uint64_t ts;
+    std::string addr;
+    uint32_t count;
+};
+// Bytes moved to and from one path.
+struct IoVolume {
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+};
 struct ProcessProvOperations {
     std::vector<ProcessProvOperation> reads;
     std::vector<ProcessProvOperation> writes;
@@ -154,6 +196,9 @@ struct ProcessProvOperations {
     std::vector<ProcessProvNamebind> link;
     std::vector<ProcessProvNamebind> symlink;
     std::vector<ProcessProvOperation> deletes;
+    std::vector<ProcessProvNet> net_sends;
+    std::vector<ProcessProvNet> net_recvs;
+    std::unordered_map<std::string, IoVolume> volume;
 };
 
 struct ProcessProvData {
@@ -169,6 +214,7 @@ struct ExecProvOperations {
     std::unordered_set<std::string> reads;
     std::unordered_set<std::string> writes;
     std::unordered_set<std::string> executes;
+    std::unordered_map<std::string, IoVolume> volume;
 };
 
 struct ExecProvData {
@@ -179,6 +225,13 @@ struct ExecProvData {
     std::unordered_map<std::string, std::string> symlink_map;
     ExecProvOperations prov_operations;
     std::unordered_map<uint64_t, ProcessProvData> process_map;
+    Overhead overhead;
+    // By path; a file written again later in the step takes the new digest.
+    std::unordered_map<std::string, FileDigest> digests;
+    // By path, then kind of I/O.
+    std::unordered_map<std::string,
+                       std::unordered_map<std::string, LatencyHistogram>>
+        latencies;
 };
 
 struct ProcessedJobData {
@@ -1,3 +1,10 @@
 #include <model.hpp>
 
-void process_parsed_requests(ParsedRequestQueue* parsed_batch);
+// What is reported besides the job data printed at each job's end.
+struct ProcessorOptions {
+    // Paths by I/O latency for every exec step (--latencies).
+    bool report_latencies = false;
+};
+
+void process_parsed_requests(ParsedRequestQueue* parsed_batch,
+                             ProcessorOptions options);
@@ -2,20 +2,31 @@
 #include <iostream>
 #include <mutex>
 #include <string>
+#include <string_view>
 
 #include "logserver.hpp"
 #include "model.hpp"
 #include "parser.hpp"
 #include "processor.hpp"
 
-int main() {
+int main(int argc, char** argv) {
+    ProcessorOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--latencies") {
+            options.report_latencies = true;
+            continue;
+        }
+        std::cerr << "usage: " << argv[0] << " [--latencies]\n";
+        return 1;
+    }
     std::mutex data_mutex;
     ParsedRequestQueue parsed_requests;
     std::string url = "127.0.0.1";
     int port = 9000;
     LogServer server(url, port);
     auto fut = std::async(std::launch::async, process_parsed_requests,
-                          &parsed_requests);
+                          &parsed_requests, options);
     server.set_log_handler(
         [&](const httplib::Request& req, httplib::Response& res) {
             {
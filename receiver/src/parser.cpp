@@ -1,6 +1,11 @@
 #include "parser.hpp"
 
+#include <arpa/inet.h>
 #include <simdjson.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstring>
 
 using namespace simdjson;
 
@@ -20,6 +25,128 @@ static uint64_t get_uint64(ondemand::object& obj, const char* name) {
     return 0;
 }
 
+static int64_t get_int64(ondemand::object& obj, const char* name) {
+    auto s = obj.find_field_unordered(name).get_int64();
+    if (!s.error()) {
+        return s.value();
+    }
+    return -1;
+}
+
+// Coalesced I/O events carry the number of calls they stand for.
+static uint32_t event_count(ondemand::object& obj) {
+    uint64_t count = get_uint64(obj, "count");
+    return count ? static_cast<uint32_t>(count) : 1;
+}
+
+// Formats the raw sockaddr of a network event (hex-encoded by the injector)
+// as host:port, a socket path, or the bare family for other families and
+// truncated addresses.
+static std::string format_sockaddr(std::string_view hex) {
+    sockaddr_storage storage{};
+    size_t size = std::min(hex.size() / 2, sizeof(storage));
+    if (size < sizeof(sa_family_t)) return "";
+    auto nibble = [](char c) {
+        return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+    };
+    auto* bytes = reinterpret_cast<unsigned char*>(&storage);
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = nibble(hex[2 * i]) << 4 | nibble(hex[2 * i + 1]);
+    char host[INET6_ADDRSTRLEN] = {0};
+    switch (storage.ss_family) {
+        case AF_INET: {
+            if (size < sizeof(sockaddr_in)) break;
+            auto* in = reinterpret_cast<sockaddr_in*>(&storage);
+            inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+            return std::string(host) + ":"
+                   + std::to_string(ntohs(in->sin_port));
+        }
+        case AF_INET6: {
+            if (size < sizeof(sockaddr_in6)) break;
+            auto* in6 = reinterpret_cast<sockaddr_in6*>(&storage);
+            inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+            return "[" + std::string(host)
+                   + "]:" + std::to_string(ntohs(in6->sin6_port));
+        }
+        case AF_UNIX: {
+            auto* un = reinterpret_cast<sockaddr_un*>(&storage);
+            if (size <= offsetof(sockaddr_un, sun_path)) return "unix:";
+            size_t path_size = size - offsetof(sockaddr_un, sun_path);
+            // Abstract names start with a NUL byte and are not terminated.
+            if (un->sun_path[0] == '\0')
+                return "unix:@" + std::string(un->sun_path + 1, path_size - 1);
+            return "unix:"
+                   + std::string(un->sun_path,
+                                 strnlen(un->sun_path, path_size));
+        }
+    }
+    return "family=" + std::to_string(storage.ss_family);
+}
+
+static Overhead parse_overhead(ondemand::object& obj) {
+    Overhead overhead{.processes = 1,
+                      .events = get_uint64(obj, "events"),
+                      .dropped = get_uint64(obj, "dropped"),
+                      .hooks = {}};
+    auto hooks = obj.find_field_unordered("hooks").get_array();
+    if (hooks.error()) return overhead;
+    for (ondemand::value hook_val : hooks.value()) {
+        auto hook_res = hook_val.get_object();
+        if (hook_res.error()) continue;
+        auto hook = hook_res.value();
+        HookOverhead& cost = overhead.hooks[get_string(hook, "call")];
+        cost.calls += get_uint64(hook, "calls");
+        cost.log_ns += get_uint64(hook, "log_ns");
+    }
+    return overhead;
+}
+
+static PathLatency parse_latency(ondemand::object& obj) {
+    PathLatency latency{.path = get_string(obj, "path"),
+                        .io = get_string(obj, "io"),
+                        .histogram = {}};
+    LatencyHistogram& histogram = latency.histogram;
+    histogram.calls = get_uint64(obj, "calls");
+    histogram.total_ns = get_uint64(obj, "total_ns");
+    auto buckets = obj.find_field_unordered("histogram").get_array();
+    if (buckets.error()) return latency;
+    for (ondemand::value bucket_val : buckets.value()) {
+        auto pair = bucket_val.get_array();
+        if (pair.error()) continue;
+        uint64_t fields[2] = {0, 0};
+        size_t n = 0;
+        for (ondemand::value field : pair.value()) {
+            auto value = field.get_uint64();
+            if (n < 2 && !value.error()) fields[n] = value.value();
+            n++;
+        }
+        histogram.buckets[static_cast<uint32_t>(fields[0])] += fields[1];
+    }
+    return latency;
+}
+
+static ProcessSummary parse_summary(ondemand::object& obj) {
+    ProcessSummary summary;
+    auto paths = obj.find_field_unordered("paths").get_array();
+    if (paths.error()) return summary;
+    for (ondemand::value path_val : paths.value()) {
+        auto path_res = path_val.get_object();
+        if (path_res.error()) continue;
+        auto path = path_res.value();
+        SummaryEntry entry;
+        if (!sysop_from_name(get_string(path, "op"), entry.op)) continue;
+        entry.path = get_string(path, "path_out");
+        entry.output = !entry.path.empty();
+        if (!entry.output) entry.path = get_string(path, "path_in");
+        entry.count = get_uint64(path, "count");
+        entry.bytes = get_uint64(path, "bytes");
+        entry.first_ts = get_uint64(path, "first_ts");
+        entry.last_ts = get_uint64(path, "last_ts");
+        summary.entries.push_back(std::move(entry));
+    }
+    return summary;
+}
+
 CallType get_call_type(std::string& type) {
     CallType current_call_type;
     if (type == "start") {
@@ -28,6 +155,8 @@ CallType get_call_type(std::string& type) {
         current_call_type = CallType::End;
     } else if (type == "exec") {
         current_call_type = CallType::Exec;
+    } else if (type == "exec_batch") {
+        current_call_type = CallType::ExecBatch;
     }
     return current_call_type;
 }
@@ -41,13 +170,14 @@ static inline bool one_of(std::string_view t, std::string_view a, Ss... s) {
 }
 static SysOp sysop_from(std::string_view t) {
     using O = SysOp;
-    if (one_of(t, "WRITE", "FWRITE", "DPRINTF", "FPUTS", "FPRINTF", "VFPRINTF",
-               "FPUTC", "FPUTS_UNLOCKED", "FWRITE_UNLOCKED"))
+    if (one_of(t, "WRITE", "FWRITE", "DPRINTF", "VDPRINTF", "FPUTS", "FPRINTF",
+               "VFPRINTF", "FPUTC", "FPUTS_UNLOCKED", "FWRITE_UNLOCKED"))
         return O::Write;
     if (one_of(t, "WRITEV", "PWRITEV", "PWRITEV2")) return O::Writev;
     if (one_of(t, "PWRITE", "PWRITE64")) return O::Pwrite;
     if (one_of(t, "TRUNCATE", "FTRUNCATE")) return O::Truncate;
     if (one_of(t, "MSYNC")) return O::Msync;
+    if (one_of(t, "POSIX_FALLOCATE")) return O::Fallocate;
     if (one_of(t, "READ")) return O::Read;
     if (one_of(t, "READV", "PREADV", "PREADV2")) return O::Readv;
     if (one_of(t, "PREAD", "PREAD64")) return O::Pread;
@@ -73,8 +203,8 @@ static SysOp sysop_from(std::string_view t) {
     if (one_of(t, "SYSTEM")) return O::System;
     if (one_of(t, "POSIX_SPAWN", "POSIX_SPAWNP")) return O::Spawn;
     if (one_of(t, "FORK", "VFORK", "CLONE")) return O::Fork;
-    if (one_of(t, "PROCESS_START")) return O::ProcessStart;
-    if (one_of(t, "PROCESS_END")) return O::ProcessEnd;
+    if (one_of(t, "PROCESS_START", "START_PROCESS")) return O::ProcessStart;
+    if (one_of(t, "PROCESS_END", "END_PROCESS")) return O::ProcessEnd;
     if (one_of(t, "JOB_START")) return O::JobStart;
     if (one_of(t, "JOB_END")) return O::JobEnd;
     return O::Unknown;
@@ -97,6 +227,7 @@ std::queue<Event> parse_events(ondemand::object& payload) {
         uint64_t ts = get_uint64(hdr, "ts");
         std::string op = get_string(hdr, "operation");
         uint64_t pid = get_uint64(hdr, "pid");
+        uint64_t tid = get_uint64(hdr, "tid");
 
         ondemand::object event_data{};
         if (auto dr = event_obj.find_field_unordered("event_data").get_object();
@@ -107,6 +238,7 @@ std::queue<Event> parse_events(ondemand::object& payload) {
         Event new_event;
         new_event.ts = ts;
         new_event.pid = pid;
+        new_event.tid = tid;
         new_event.operation = sysop_from(op);
         using O = SysOp;
         switch (sysop_from(op)) {
@@ -121,8 +253,11 @@ std::queue<Event> parse_events(ondemand::object& payload) {
             case O::Readv:
             case O::Pread:
             case O::Preadv:
+            case O::Getdents:
                 new_event.event_payload
-                    = AccessIn{.path_in = get_string(event_data, "path_in")};
+                    = AccessIn{.path_in = get_string(event_data, "path_in"),
+                               .count = event_count(event_data),
+                               .bytes = get_uint64(event_data, "bytes")};
                 break;
             case O::Write:
             case O::Writev:
@@ -131,7 +266,9 @@ std::queue<Event> parse_events(ondemand::object& payload) {
             case O::Truncate:
             case O::Fallocate:
                 new_event.event_payload
-                    = AccessOut{.path_out = get_string(event_data, "path_out")};
+                    = AccessOut{.path_out = get_string(event_data, "path_out"),
+                                .count = event_count(event_data),
+                                .bytes = get_uint64(event_data, "bytes")};
                 break;
             case O::Transfer:
             case O::Rename:
@@ -139,7 +276,8 @@ std::queue<Event> parse_events(ondemand::object& payload) {
             case O::SymLink:
                 new_event.event_payload = AccessInOut{
                     .path_in = get_string(event_data, "path_in"),
-                    .path_out = get_string(event_data, "path_out")};
+                    .path_out = get_string(event_data, "path_out"),
+                    .bytes = get_uint64(event_data, "bytes")};
                 break;
             case O::Exec:
             case O::System:
@@ -155,6 +293,27 @@ std::queue<Event> parse_events(ondemand::object& payload) {
                 new_event.event_payload = ForkCall{
                     .child_pid = get_uint64(event_data, "child_pid")};
                 break;
+            case O::NetSend:
+            case O::NetRecv:
+                new_event.event_payload = NetCall{
+                    .fd = get_int64(event_data, "fd"),
+                    .count = event_count(event_data),
+                    .addr = format_sockaddr(
+                        get_string(event_data, "sockaddr"))};
+                break;
+            case O::Unknown:
+                if (op == "OVERHEAD")
+                    new_event.event_payload = parse_overhead(event_data);
+                if (op == "LATENCY")
+                    new_event.event_payload = parse_latency(event_data);
+                if (op == "SUMMARY")
+                    new_event.event_payload = parse_summary(event_data);
+                if (op == "FILE_DIGEST")
+                    new_event.event_payload = FileDigest{
+                        .path = get_string(event_data, "path"),
+                        .bytes = get_uint64(event_data, "bytes"),
+                        .xxh3_128 = get_string(event_data, "xxh3_128")};
+                break;
         }
         processedEvents.push(new_event);
     }
@@ -172,9 +331,11 @@ ParsedRequest parse_request(const std::string& json_body) {
     new_request.type = get_call_type(type);
     new_request.job_id = get_string(hdr, "slurm_job_id");
     new_request.cluster_name = get_string(hdr, "slurm_cluster_name");
+    new_request.session = get_string(hdr, "session");
     auto payload = env.find_field_unordered("payload").get_object().value();
     new_request.path = get_string(payload, "path");
-    if (new_request.type == CallType::Exec) {
+    if (new_request.type == CallType::Exec
+        || new_request.type == CallType::ExecBatch) {
         new_request.request_payload = Exec{0, 0, parse_events(payload)};
     }
     return new_request;
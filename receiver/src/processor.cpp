@@ -1,13 +1,34 @@
+#include <algorithm>
 #include <iostream>
 #include <model.hpp>
+#include <processor.hpp>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 
 // tmp debug output
 
+// Paths by bytes moved, largest first.
+void print_volume(const std::unordered_map<std::string, IoVolume>& volume) {
+    if (volume.empty()) return;
+    std::vector<std::pair<std::string, IoVolume>> paths(volume.begin(),
+                                                        volume.end());
+    auto total = [](const IoVolume& v) {
+        return v.bytes_read + v.bytes_written;
+    };
+    std::sort(paths.begin(), paths.end(), [&](const auto& a, const auto& b) {
+        return total(a.second) > total(b.second);
+    });
+    std::cout << "I/O Volume:\n";
+    for (const auto& [path, v] : paths) {
+        std::cout << "  " << path << ": read=" << v.bytes_read
+                  << ", written=" << v.bytes_written << "\n";
+    }
+}
+
 void print_process_operations(const ProcessProvOperations& ops) {
     auto print_vec = [](const auto& vec, const std::string& name) {
         using Elem = typename std::decay_t<decltype(vec)>::value_type;
@@ -23,6 +44,9 @@ void print_process_operations(const ProcessProvOperations& ops) {
             } else if constexpr (std::is_same_v<Elem, ProcessProvNamebind>) {
                 std::cout << "  ts=" << op.ts << ", source=" << op.path_source
                           << ", target=" << op.path_target << "\n";
+            } else if constexpr (std::is_same_v<Elem, ProcessProvNet>) {
+                std::cout << "  ts=" << op.ts << ", addr=" << op.addr
+                          << ", count=" << op.count << "\n";
             }
         }
     };
@@ -34,6 +58,9 @@ void print_process_operations(const ProcessProvOperations& ops) {
     print_vec(ops.link, "Links");
     print_vec(ops.symlink, "Symlinks");
     print_vec(ops.deletes, "Deletes");
+    print_vec(ops.net_sends, "Net Sends");
+    print_vec(ops.net_recvs, "Net Receives");
+    print_volume(ops.volume);
 }
 
 void print_process_data(const ExecProvData& exec) {
@@ -55,6 +82,21 @@ void print_set(const std::unordered_set<std::string>& s,
     std::cout << "}" << std::endl;
 }
 
+void print_overhead(const Overhead& overhead) {
+    std::vector<std::pair<std::string, HookOverhead>> hooks(
+        overhead.hooks.begin(), overhead.hooks.end());
+    std::sort(hooks.begin(), hooks.end(), [](const auto& a, const auto& b) {
+        return a.second.log_ns > b.second.log_ns;
+    });
+    std::cout << "Tracing Overhead: " << overhead.processes << " processes, "
+              << overhead.events << " events, " << overhead.dropped
+              << " dropped\n";
+    for (const auto& [call, cost] : hooks) {
+        std::cout << "  " << call << ": calls=" << cost.calls
+                  << ", log_ns=" << cost.log_ns << "\n";
+    }
+}
+
 void print_exec_data(const ExecProvData& exec) {
     std::cout << "Exec Step Name: " << exec.step_name << "\n"
               << "Start Time: " << exec.start_time << "\n"
@@ -63,6 +105,7 @@ void print_exec_data(const ExecProvData& exec) {
     print_set(exec.prov_operations.reads, "Exec Reads");
     print_set(exec.prov_operations.writes, "Exec Writes");
     print_set(exec.prov_operations.executes, "Exec Executes");
+    print_volume(exec.prov_operations.volume);
 
     if (!exec.rename_map.empty()) {
         std::cout << "Rename Map: { ";
@@ -80,6 +123,19 @@ void print_exec_data(const ExecProvData& exec) {
         std::cout << "}" << std::endl;
     }
 
+    if (!exec.digests.empty()) {
+        std::cout << "Output Digests: { ";
+        for (const auto& [path, digest] : exec.digests) {
+            std::cout << path << "="
+                      << (digest.xxh3_128.empty() ? "rehash"
+                                                  : digest.xxh3_128)
+                      << " ";
+        }
+        std::cout << "}" << std::endl;
+    }
+
+    if (exec.overhead.processes) print_overhead(exec.overhead);
+
     std::cout << "---- Process-Level Provenance ----" << std::endl;
     print_process_data(exec);
     std::cout << "-------------------------------------" << std::endl;
@@ -105,6 +161,48 @@ void print_full_job_data(const ProcessedJobData& job) {
 }
 //
 
+// Upper bound of the bucket holding the given fraction of the calls.
+uint64_t latency_quantile(const LatencyHistogram& histogram, double fraction) {
+    uint64_t rank = static_cast<uint64_t>(histogram.calls * fraction);
+    uint64_t seen = 0;
+    for (const auto& [bucket, count] : histogram.buckets) {
+        seen += count;
+        if (seen > rank) return uint64_t{2} << bucket;
+    }
+    return 0;
+}
+
+// The I/O latency report (--latencies): each exec step's paths and kinds of
+// I/O, by total time spent in the real calls, most first.
+void print_latency_report(const ProcessedJobData& job) {
+    std::cout << "=== I/O Latency, Job ID: " << job.job_id << " ===\n";
+    std::queue<ExecProvData> exec_queue_copy = job.exec_prov_data_queue;
+    for (; !exec_queue_copy.empty(); exec_queue_copy.pop()) {
+        const ExecProvData& exec = exec_queue_copy.front();
+        std::vector<std::tuple<std::string, std::string, LatencyHistogram>>
+            ranked;
+        for (const auto& [path, kinds] : exec.latencies)
+            for (const auto& [io, histogram] : kinds)
+                if (histogram.calls) ranked.emplace_back(path, io, histogram);
+        if (ranked.empty()) continue;
+        std::sort(ranked.begin(), ranked.end(),
+                  [](const auto& a, const auto& b) {
+                      return std::get<2>(a).total_ns > std::get<2>(b).total_ns;
+                  });
+        std::cout << "Exec Step Name: " << exec.step_name << "\n";
+        for (const auto& [path, io, histogram] : ranked) {
+            std::cout << "  " << path << " " << io
+                      << ": calls=" << histogram.calls
+                      << ", total_ns=" << histogram.total_ns
+                      << ", mean_ns=" << histogram.total_ns / histogram.calls
+                      << ", p50_ns<=" << latency_quantile(histogram, 0.5)
+                      << ", p99_ns<=" << latency_quantile(histogram, 0.99)
+                      << "\n";
+        }
+    }
+    std::cout << std::endl;
+}
+
 struct RecordParameters {
     std::unordered_map<std::string, std::string>& exec_rename_map;
     std::unordered_map<std::string, std::string>& exec_symlink_map;
@@ -182,6 +280,15 @@ void record_read(const uint64_t& ts, const std::string& path,
                                                        record_parameters);
 }
 
+// Adds to the path's byte totals for the process and the exec step.
+template <uint64_t IoVolume::* Direction>
+void record_volume(const std::string& path, uint64_t bytes,
+                   RecordParameters& record_parameters) {
+    if (!bytes) return;
+    record_parameters.process_prov_operations.volume[path].*Direction += bytes;
+    record_parameters.exec_prov_operations.volume[path].*Direction += bytes;
+}
+
 void record_execute_exec(const uint64_t& ts, const std::string& path,
                          RecordParameters& record_parameters) {
     record_exec_path<&ExecProvOperations::executes>(path, record_parameters);
@@ -193,6 +300,14 @@ void record_delete(const uint64_t& ts, const std::string& path,
                                                          record_parameters);
 }
 
+template <std::vector<ProcessProvNet> ProcessProvOperations::* NetOps>
+void record_net(uint64_t ts, const NetCall& net_call,
+                RecordParameters& record_parameters) {
+    ProcessProvNet net{
+        .ts = ts, .addr = net_call.addr, .count = net_call.count};
+    (record_parameters.process_prov_operations.*NetOps).push_back(net);
+}
+
 void record_process_exec(const uint64_t& ts, const std::string& path,
                          const uint64_t& child_pid,
                          RecordParameters& record_parameters) {
@@ -251,8 +366,65 @@ std::pair<std::string, std::string> case_link_body(
     return std::make_pair(path_out, path_in);
 }
 
-void process_exec(const Exec& exec, ProcessedJobData& processed_job_data) {
-    ExecProvData current_exec_prov_data;
+void add_overhead(Overhead& total, const Overhead& process) {
+    total.processes += process.processes;
+    total.events += process.events;
+    total.dropped += process.dropped;
+    for (const auto& [call, cost] : process.hooks) {
+        HookOverhead& hook = total.hooks[call];
+        hook.calls += cost.calls;
+        hook.log_ns += cost.log_ns;
+    }
+}
+
+void add_latency(LatencyHistogram& total, const LatencyHistogram& process) {
+    total.calls += process.calls;
+    total.total_ns += process.total_ns;
+    for (const auto& [bucket, count] : process.buckets)
+        total.buckets[bucket] += count;
+}
+
+// Records the paths of a process's SUMMARY as its reads and writes, at the
+// time each was first touched. The summary comes after the process's end,
+// so the step's renames are applied to the writes again.
+void record_summary(const ProcessSummary& summary,
+                    RecordParameters& record_parameters) {
+    for (const SummaryEntry& entry : summary.entries) {
+        switch (entry.op) {
+            case SysOp::Write:
+            case SysOp::Writev:
+            case SysOp::Pwrite:
+            case SysOp::Pwritev:
+            case SysOp::Truncate:
+            case SysOp::Fallocate:
+            case SysOp::Read:
+            case SysOp::Readv:
+            case SysOp::Pread:
+            case SysOp::Preadv:
+            case SysOp::Transfer:
+                break;
+            case SysOp::Getdents:
+                record_read(entry.first_ts, entry.path, record_parameters);
+                continue;
+            default:
+                continue;
+        }
+        if (entry.output) {
+            record_write(entry.first_ts, entry.path, record_parameters);
+            record_volume<&IoVolume::bytes_written>(entry.path, entry.bytes,
+                                                    record_parameters);
+        } else {
+            record_read(entry.first_ts, entry.path, record_parameters);
+            record_volume<&IoVolume::bytes_read>(entry.path, entry.bytes,
+                                                 record_parameters);
+        }
+    }
+    rename_writes(record_parameters);
+}
+
+// Adds the events of one exec or exec_batch request to what is known of the
+// exec step.
+void process_exec(const Exec& exec, ExecProvData& current_exec_prov_data) {
     ExecProvOperations& exec_prov_operations
         = current_exec_prov_data.prov_operations;
     std::unordered_map<std::string, std::string>& exec_rename_map
@@ -301,6 +473,8 @@ void process_exec(const Exec& exec, ProcessedJobData& processed_job_data) {
                 AccessOut access_out = std::get<AccessOut>(event_payload);
                 std::string path_out = access_out.path_out;
                 record_write(event_ts, path_out, record_parameters);
+                record_volume<&IoVolume::bytes_written>(
+                    path_out, access_out.bytes, record_parameters);
                 break;
             }
             case SysOp::Read:
@@ -310,6 +484,15 @@ void process_exec(const Exec& exec, ProcessedJobData& processed_job_data) {
                 AccessIn access_in = std::get<AccessIn>(event_payload);
                 std::string path_in = access_in.path_in;
                 record_read(event_ts, path_in, record_parameters);
+                record_volume<&IoVolume::bytes_read>(path_in, access_in.bytes,
+                                                     record_parameters);
+                break;
+            }
+            // Listing a directory reads it; the bytes are directory entries,
+            // not file data, so they are left out of the volume.
+            case SysOp::Getdents: {
+                AccessIn access_in = std::get<AccessIn>(event_payload);
+                record_read(event_ts, access_in.path_in, record_parameters);
                 break;
             }
             case SysOp::Transfer: {
@@ -319,6 +502,10 @@ void process_exec(const Exec& exec, ProcessedJobData& processed_job_data) {
                 std::string path_in = access_in_out.path_in;
                 record_write(event_ts, path_out, record_parameters);
                 record_read(event_ts, path_in, record_parameters);
+                record_volume<&IoVolume::bytes_written>(
+                    path_out, access_in_out.bytes, record_parameters);
+                record_volume<&IoVolume::bytes_read>(
+                    path_in, access_in_out.bytes, record_parameters);
                 break;
             }
             case SysOp::Rename: {
@@ -378,16 +565,48 @@ void process_exec(const Exec& exec, ProcessedJobData& processed_job_data) {
                 record_process_exec(event_ts, "", child_pid, record_parameters);
                 break;
             }
+            case SysOp::NetSend: {
+                const auto& net_call = std::get<NetCall>(event_payload);
+                record_net<&ProcessProvOperations::net_sends>(
+                    event_ts, net_call, record_parameters);
+                break;
+            }
+            case SysOp::NetRecv: {
+                const auto& net_call = std::get<NetCall>(event_payload);
+                record_net<&ProcessProvOperations::net_recvs>(
+                    event_ts, net_call, record_parameters);
+                break;
+            }
+            case SysOp::Unknown: {
+                const auto* overhead = std::get_if<Overhead>(&event_payload);
+                if (overhead)
+                    add_overhead(current_exec_prov_data.overhead, *overhead);
+                const auto* digest = std::get_if<FileDigest>(&event_payload);
+                if (digest)
+                    current_exec_prov_data.digests[digest->path] = *digest;
+                const auto* latency = std::get_if<PathLatency>(&event_payload);
+                if (latency)
+                    add_latency(current_exec_prov_data
+                                    .latencies[latency->path][latency->io],
+                                latency->histogram);
+                const auto* summary
+                    = std::get_if<ProcessSummary>(&event_payload);
+                if (summary) record_summary(*summary, record_parameters);
+                break;
+            }
             default:
                 break;
         }
         events.pop();
     }
-    processed_job_data.exec_prov_data_queue.push(current_exec_prov_data);
 }
 
-void process_parsed_requests(ParsedRequestQueue* parsed_request) {
+void process_parsed_requests(ParsedRequestQueue* parsed_request,
+                             ProcessorOptions options) {
     std::unordered_map<std::string, ProcessedJobData> processed_job_data_map;
+    // Exec steps whose batches have come in but not yet their exec request,
+    // by job and session.
+    std::unordered_map<std::string, ExecProvData> open_exec_map;
     while (true) {
         std::queue<ParsedRequest> request_copy = parsed_request->take_all();
         while (!request_copy.empty()) {
@@ -410,10 +629,27 @@ void process_parsed_requests(ParsedRequestQueue* parsed_request) {
                     request_copy_element.request_payload);
                 processed_job_data_map[prov_data_key].end_time = end.ts;
                 print_full_job_data(processed_job_data_map[prov_data_key]);
+                if (options.report_latencies)
+                    print_latency_report(processed_job_data_map[prov_data_key]);
+            } else if (request_copy_element.type == CallType::ExecBatch) {
+                Exec batch
+                    = std::get<Exec>(request_copy_element.request_payload);
+                process_exec(batch,
+                             open_exec_map[prov_data_key
+                                           + request_copy_element.session]);
             } else if (request_copy_element.type == CallType::Exec) {
                 Exec exec
                     = std::get<Exec>(request_copy_element.request_payload);
-                process_exec(exec, processed_job_data_map[prov_data_key]);
+                ExecProvData exec_prov_data{};
+                auto open_exec = open_exec_map.find(
+                    prov_data_key + request_copy_element.session);
+                if (open_exec != open_exec_map.end()) {
+                    exec_prov_data = std::move(open_exec->second);
+                    open_exec_map.erase(open_exec);
+                }
+                process_exec(exec, exec_prov_data);
+                processed_job_data_map[prov_data_key]
+                    .exec_prov_data_queue.push(std::move(exec_prov_data));
             }
             request_copy.pop();
         }